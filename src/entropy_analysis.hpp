@@ -0,0 +1,271 @@
+#pragma once
+
+#include "entropy_store.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace entropy_store
+{
+// Computes how much entropy a store loses generating a distribution, without generating anything.
+//
+// Only the size s of the store matters, since U_s is uniform given s. When s is below the threshold
+// T of its refill policy, the store refills while s < N, multiplying s by the size b of the source
+// each time. It then resamples s down to a multiple of n,
+// the total weight of the distribution, and keeps k * w_i for output i where k = s / n. Resampling
+// keeps s - r with probability (s - r) / s, where r = s mod n, and otherwise keeps r and tries again.
+// This loses h((s - r) / s) bits in expectation, where h is the binary entropy function, and is the
+// only place the store loses entropy for the uniform, Bernoulli and weighted distributions analyzed
+// here. Distributions that reject whole draws lose more.
+
+// The store's limit N and source size b, as entropy_store computes them
+struct store_configuration
+{
+    std::uint64_t N;
+    std::uint64_t source_size = 2;
+    // The size below which the store refills, or 0 to refill below N as max_efficiency does
+    std::uint64_t threshold = 0;
+};
+
+template <std::integral Buffer> store_configuration configuration_of(const auto &source_distribution)
+{
+    static_assert(sizeof(Buffer) <= sizeof(std::uint64_t), "The analysis works with buffers of up to 64 bits");
+    return {std::uint64_t(Buffer(1) << (8 * sizeof(Buffer) - source_distribution.bits())),
+            std::uint64_t(source_distribution.size())};
+}
+
+// The configuration of a store that refills by RefillPolicy, for outputs of n outcomes
+template <typename RefillPolicy> store_configuration refilling_by(store_configuration config, std::uint64_t n)
+{
+    config.threshold = RefillPolicy::threshold(config.N, n);
+    return config;
+}
+
+struct efficiency_analysis
+{
+    std::uint64_t outputs = 0;
+    // Per output
+    double output_bits = 0, lost_bits = 0;
+    // A bound on the error in lost_bits. When exact, this is proven from the probability of the
+    // states that were not followed, and otherwise it is four standard errors of a sampled path.
+    double error = 0;
+    bool exact = true;
+
+    double consumed_bits() const
+    {
+        return output_bits + lost_bits;
+    }
+
+    double efficiency() const
+    {
+        return output_bits / consumed_bits();
+    }
+};
+
+// The binary entropy function, accurate for tiny p
+inline double binary_entropy(double p)
+{
+    if (p <= 0 || p >= 1)
+        return 0;
+    return (-p * std::log(p) - (1 - p) * std::log1p(-p)) / std::log(2.0);
+}
+
+// An upper bound on the expected bits lost per output of n outcomes, from rejection sampling at
+// least N values: each attempt loses at most h(p) and fails with probability at most p = (n-1)/N,
+// and always less than 1/2, since the rejected values are fewer than n and than those kept.
+inline double worst_case_loss(std::uint64_t n, std::uint64_t N)
+{
+    double p = std::min(double(n - 1) / N, 0.5);
+    return binary_entropy(p) / (1 - p);
+}
+
+// As worst_case_loss, for a store that refills below its configured threshold
+inline double worst_case_loss(std::uint64_t n, const store_configuration &config)
+{
+    return worst_case_loss(n, config.threshold ? config.threshold : config.N);
+}
+
+namespace detail
+{
+    inline std::uint64_t refill(std::uint64_t s, const store_configuration &config)
+    {
+        if (s < (config.threshold ? config.threshold : config.N))
+            while (s < config.N)
+                s *= config.source_size;
+        return s;
+    }
+
+    // A size of the store and its probability
+    struct state
+    {
+        std::uint64_t s;
+        double p;
+    };
+
+    // Merges states of equal size, and moves those with probability below `negligible` to `dropped`,
+    // keeping at most `max_states` of the most likely
+    inline void merge(std::vector<state> &states, double negligible, std::size_t max_states, double &dropped)
+    {
+        std::ranges::sort(states, {}, &state::s);
+        std::size_t size = 0;
+        for (auto &x : states)
+        {
+            if (size > 0 && states[size - 1].s == x.s)
+                states[size - 1].p += x.p;
+            else
+                states[size++] = x;
+        }
+        states.resize(size);
+        if (states.size() > max_states)
+        {
+            std::ranges::nth_element(states, states.begin() + max_states, std::ranges::greater{}, &state::p);
+            for (auto i = states.begin() + max_states; i != states.end(); ++i)
+                dropped += i->p;
+            states.resize(max_states);
+        }
+        std::erase_if(states, [&](auto &x) { return x.p < negligible && (dropped += x.p, true); });
+    }
+
+    // Follows the distribution of the store's size through `outputs` outputs from an empty store.
+    // An output of total weight n keeps k * w with probability `p` for each (w, p) in `kept`.
+    inline efficiency_analysis analyze(const store_configuration &config, std::uint64_t n, std::uint64_t outputs,
+                                       double output_bits, std::span<const state> kept, std::size_t max_states)
+    {
+        assert(n > 0 && 2 * (n - 1) <= config.N && config.source_size >= 2 && outputs > 0);
+        constexpr double negligible = 1e-12;
+        assert(config.threshold == 0 || (config.threshold >= n && config.threshold <= config.N));
+        const double worst = worst_case_loss(n, config);
+
+        std::vector<state> states{{1, 1}}, next, rejected;
+        double total_lost = 0, error = 0;
+        for (std::uint64_t t = 0; t < outputs; ++t)
+        {
+            // The store resamples until it succeeds, so this follows the sizes left by failed samples
+            double dropped = 0;
+            next.clear();
+            while (!states.empty())
+            {
+                rejected.clear();
+                for (auto [s, p] : states)
+                {
+                    s = refill(s, config);
+                    auto r = s % n;
+                    total_lost += p * binary_entropy(double(r) / s);
+                    for (auto [w, q] : kept)
+                        next.push_back({s / n * w, p * q * double(s - r) / s});
+                    if (r > 0)
+                        rejected.push_back({r, p * r / s});
+                }
+                merge(rejected, negligible, max_states, dropped);
+                std::swap(states, rejected);
+            }
+            merge(next, negligible, max_states, dropped);
+            std::swap(states, next);
+            // Dropped states lose between 0 and the worst case on each remaining output
+            error += dropped * worst * (outputs - t);
+        }
+
+        efficiency_analysis result;
+        result.outputs = outputs;
+        result.output_bits = output_bits;
+        result.lost_bits = total_lost / outputs;
+        result.error = error / outputs;
+        return result;
+    }
+
+    inline double output_entropy(std::span<const std::uint32_t> weights, std::uint64_t n)
+    {
+        double result = 0;
+        for (auto w : weights)
+            if (w > 0)
+                result -= double(w) / n * std::log2(double(w) / n);
+        return result;
+    }
+} // namespace detail
+
+// The store's expected loss, averaged over its first `outputs` outputs, for uniform values over n
+// outcomes. The store keeps a single size unless a sample fails, and the paths after failed samples
+// are followed until there are more than `max_states` of them.
+inline efficiency_analysis analyze_uniform(const store_configuration &config, std::uint64_t n,
+                                           std::uint64_t outputs = 1000, std::size_t max_states = 256)
+{
+    const detail::state kept[] = {{1, 1}};
+    return detail::analyze(config, n, outputs, std::log2(double(n)), kept, max_states);
+}
+
+// As analyze_uniform, where output i has weight weights[i]. Each distinct weight multiplies the
+// sizes the store can have, so the number of sizes followed is limited by `max_states`, and the
+// probability of those left out is added to the error. Use estimate_weighted when this is too slow
+// or too loose.
+inline efficiency_analysis analyze_weighted(const store_configuration &config, std::span<const std::uint32_t> weights,
+                                            std::uint64_t outputs = 1000, std::size_t max_states = 256)
+{
+    std::uint64_t n = std::reduce(weights.begin(), weights.end(), std::uint64_t(0));
+    std::vector<detail::state> kept;
+    for (auto w : weights)
+        if (w > 0)
+            kept.push_back({w, double(w) / n});
+    double dropped = 0;
+    detail::merge(kept, 0, kept.size(), dropped);
+    return detail::analyze(config, n, outputs, detail::output_entropy(weights, n), kept, max_states);
+}
+
+inline efficiency_analysis analyze_bernoulli(const store_configuration &config, std::uint32_t m, std::uint32_t n,
+                                             std::uint64_t outputs = 1000, std::size_t max_states = 256)
+{
+    assert(m <= n);
+    const std::uint32_t weights[] = {n - m, m};
+    return analyze_weighted(config, weights, outputs, max_states);
+}
+
+// As analyze_weighted, but follows a single path of the store chosen at random, taking the expected
+// loss at each step. This costs the same for any weights, and the error is statistical.
+inline efficiency_analysis estimate_weighted(const store_configuration &config,
+                                             std::span<const std::uint32_t> weights,
+                                             std::uint64_t outputs = 1000000, std::uint64_t seed = 1)
+{
+    std::uint64_t n = std::reduce(weights.begin(), weights.end(), std::uint64_t(0));
+    assert(n > 0 && 2 * (n - 1) <= config.N && config.source_size >= 2 && outputs > 0);
+    std::mt19937_64 random{seed};
+    std::uniform_real_distribution<double> uniform;
+    std::discrete_distribution<std::size_t> choose(weights.begin(), weights.end());
+
+    // The error is taken from the means of batches of outputs
+    constexpr std::uint64_t batches = 64;
+    std::vector<double> batch_lost(batches);
+    std::uint64_t s = 1;
+    for (std::uint64_t t = 0; t < outputs; ++t)
+    {
+        // Each attempt loses its expected loss, and fails with probability p
+        for (;; s %= n)
+        {
+            s = detail::refill(s, config);
+            double p = double(s % n) / s;
+            batch_lost[t * batches / outputs] += binary_entropy(p);
+            if (uniform(random) >= p)
+                break;
+        }
+        s = s / n * weights[choose(random)];
+    }
+
+    efficiency_analysis result;
+    result.outputs = outputs;
+    result.output_bits = detail::output_entropy(weights, n);
+    result.exact = false;
+    double batch_size = double(outputs) / batches, mean = 0, variance = 0;
+    for (auto &b : batch_lost)
+        mean += (b /= batch_size) / batches;
+    for (auto b : batch_lost)
+        variance += (b - mean) * (b - mean) / (batches - 1);
+    result.lost_bits = mean;
+    result.error = 4 * std::sqrt(variance / batches);
+    return result;
+}
+
+} // namespace entropy_store
@@ -0,0 +1,1156 @@
+#pragma once
+
+#include "entropy_store.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace entropy_store
+{
+// The sum of `count` dice with `sides` sides, plus `offset`, for example 3d6+2.
+// The weights of each total are convolved once, so that the sum is generated in a single draw
+// using a weighted_distribution. When the number of totals is too large for a table, the sum is
+// generated from a single uniform over all sides^count rolls and a search of the cumulative
+// weights of the totals, as long as the store can hold sides^count values. Otherwise the dice are
+// split into parts that are each generated in the same way. This is less efficient, because the
+// entropy of how the total is split between the parts is not returned to the store.
+class dice_sum_distribution
+{
+  public:
+    using value_type = int;
+    using size_type = std::size_t;
+
+    // The largest number of outcomes stored as a weighted_distribution
+    static constexpr std::uint32_t max_table_outcomes = 1 << 12;
+
+    // The largest number of outcomes in each part
+    static constexpr std::uint32_t max_part_outcomes = 1 << 20;
+
+    // The largest number of rolls generated as a single uniform, which a 64-bit store can hold
+    static constexpr std::uint64_t max_sum_outcomes = std::uint64_t(1) << 62;
+
+    struct part
+    {
+        std::vector<std::uint32_t> cumulative;
+    };
+
+    dice_sum_distribution(std::uint32_t count, std::uint32_t sides, int offset = 0)
+        : m_count(count), m_sides(sides), m_offset(offset)
+    {
+        assert(count > 0 && sides > 0);
+
+        std::uint64_t rolls = 1;
+        for (std::uint32_t i = 0; i < count && rolls; ++i)
+            rolls = rolls <= max_sum_outcomes / sides ? rolls * sides : 0;
+        if (rolls > max_table_outcomes)
+        {
+            std::uint64_t total = 0;
+            for (auto w : convolve<std::uint64_t>(count, sides))
+                m_cumulative.push_back(total += w);
+        }
+
+        for (std::uint32_t dice = 0; dice < count;)
+        {
+            std::uint32_t part_dice = 1;
+            std::uint64_t outcomes = sides;
+            while (dice + part_dice < count && outcomes * sides <= max_part_outcomes)
+            {
+                outcomes *= sides;
+                ++part_dice;
+            }
+
+            auto weights = convolve(part_dice, sides);
+            if (part_dice == count && outcomes <= max_table_outcomes)
+            {
+                m_table.emplace(weights);
+                break;
+            }
+
+            part p;
+            std::uint32_t total = 0;
+            for (auto w : weights)
+                p.cumulative.push_back(total += w);
+            m_parts.push_back(std::move(p));
+            dice += part_dice;
+        }
+
+        // Probabilities of each total, only used for reporting
+        m_probabilities.assign(1, 1.0);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            std::vector<double> next(m_probabilities.size() + sides - 1, 0.0);
+            for (std::size_t j = 0; j < m_probabilities.size(); ++j)
+                for (std::uint32_t k = 0; k < sides; ++k)
+                    next[j + k] += m_probabilities[j] / sides;
+            m_probabilities = std::move(next);
+        }
+    }
+
+    std::uint32_t count() const
+    {
+        return m_count;
+    }
+
+    std::uint32_t sides() const
+    {
+        return m_sides;
+    }
+
+    int offset() const
+    {
+        return m_offset;
+    }
+
+    value_type min() const
+    {
+        return m_offset + int(m_count);
+    }
+
+    value_type max() const
+    {
+        return m_offset + int(m_count * m_sides);
+    }
+
+    // The table for the whole sum, if it is small enough
+    const weighted_distribution *table() const
+    {
+        return m_table ? &*m_table : nullptr;
+    }
+
+    // The cumulative weights of each total, over all sides^count rolls, if they fit in 64 bits
+    std::span<const std::uint64_t> cumulative() const
+    {
+        return m_cumulative;
+    }
+
+    std::span<const part> parts() const
+    {
+        return m_parts;
+    }
+
+    double probability(value_type total) const
+    {
+        return total >= min() && total <= max() ? m_probabilities[total - min()] : 0.0;
+    }
+
+  private:
+    // The number of ways that `count` dice can sum to each total
+    template <std::integral T = std::uint32_t> static std::vector<T> convolve(std::uint32_t count, std::uint32_t sides)
+    {
+        std::vector<T> weights{1};
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            std::vector<T> next(weights.size() + sides - 1, 0);
+            for (std::size_t j = 0; j < weights.size(); ++j)
+                for (std::uint32_t k = 0; k < sides; ++k)
+                    next[j + k] += weights[j];
+            weights = std::move(next);
+        }
+        return weights;
+    }
+
+    std::uint32_t m_count, m_sides;
+    int m_offset;
+    std::optional<weighted_distribution> m_table;
+    std::vector<std::uint64_t> m_cumulative;
+    std::vector<part> m_parts;
+    std::vector<double> m_probabilities;
+};
+
+template <std::integral uint_t>
+int generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+             const dice_sum_distribution &output_dist)
+{
+    if (auto table = output_dist.table())
+        return output_dist.min() + int(generate(U_s, s, N, fetch_entropy, *table));
+
+    if (auto cumulative = output_dist.cumulative(); !cumulative.empty() && cumulative.back() <= N)
+    {
+        uint_t U_n;
+        std::tie(U_s, s, U_n) = generate_uniform(U_s, s, N, uint_t(cumulative.back()), fetch_entropy);
+        auto i = std::upper_bound(cumulative.begin(), cumulative.end(), U_n) - cumulative.begin();
+        uint_t lower = i > 0 ? cumulative[i - 1] : 0;
+        // Return the position within the total's weight to the store
+        std::tie(U_s, s) = combine(uint_t(U_n - lower), uint_t(cumulative[i] - lower), U_s, s);
+        return output_dist.min() + int(i);
+    }
+
+    int total = output_dist.min();
+    for (auto &part : output_dist.parts())
+    {
+        uint_t U_n;
+        std::tie(U_s, s, U_n) = generate_uniform(U_s, s, N, uint_t(part.cumulative.back()), fetch_entropy);
+        auto i = std::upper_bound(part.cumulative.begin(), part.cumulative.end(), U_n) - part.cumulative.begin();
+        uint_t lower = i > 0 ? part.cumulative[i - 1] : 0;
+        // Return the position within the total's weight to the store
+        std::tie(U_s, s) = combine(uint_t(U_n - lower), uint_t(part.cumulative[i] - lower), U_s, s);
+        total += i;
+    }
+    return total;
+}
+
+// Generates a Bernoulli variable that is 1 with probability x, where digit(j) is the j-th
+// base 2^16 digit of x after the point. A uniform digit is compared with each digit of x in turn,
+// and whatever entropy the comparison does not use stays in the store.
+template <std::integral uint_t>
+uint_t generate_expansion(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                          std::invocable<std::size_t> auto digit)
+{
+    const uint_t D = 1 << 16;
+    for (std::size_t j = 0;; ++j)
+    {
+        uint_t x_j = digit(j);
+        uint_t k, B;
+        std::tie(U_s, s, k) = generate_multiple(U_s, s, N, D, fetch_entropy);
+        // Is the uniform digit less than x_j?
+        std::tie(U_s, s, B) = resample(U_s, s, k * x_j);
+        if (B)
+            return 1;
+        // Is the uniform digit equal to x_j?
+        std::tie(U_s, s, B) = resample(U_s, s, k);
+        if (!B)
+            return 0;
+    }
+}
+
+// Fixed-point numbers in [0,1), as base 2^16 digits after the point, most significant first
+using fixed_digits = std::vector<std::uint32_t>;
+
+// The product of two fixed-point numbers, rounded down or up to the same number of digits
+inline fixed_digits multiply(const fixed_digits &a, const fixed_digits &b, bool round_up)
+{
+    auto P = a.size();
+    std::vector<std::uint64_t> columns(2 * P, 0);
+    for (std::size_t i = 0; i < P; ++i)
+        for (std::size_t j = 0; j < P; ++j)
+            columns[i + j + 1] += std::uint64_t(a[i]) * b[j];
+    for (auto k = 2 * P - 1; k > 0; --k)
+    {
+        columns[k - 1] += columns[k] >> 16;
+        columns[k] &= 0xffff;
+    }
+
+    fixed_digits result(columns.begin(), columns.begin() + P);
+    if (round_up && std::any_of(columns.begin() + P, columns.end(), [](auto c) { return c != 0; }))
+    {
+        // Add one unit in the last place, saturating below 1
+        auto k = P;
+        while (k > 0 && result[k - 1] == 0xffff)
+            result[--k] = 0;
+        if (k > 0)
+            ++result[k - 1];
+        else
+            std::fill(result.begin(), result.end(), 0xffff);
+    }
+    return result;
+}
+
+// The number of failures before the first success in Bernoulli trials with probability
+// numerator/denominator of success. Values are generated exactly, in O(log(1/p)) draws
+// rather than one draw per trial. With q = 1-p, the lowest k bits of a geometric variable
+// are independent, with bit i equal to 1 with probability q^(2^i)/(1+q^(2^i)), and the
+// remaining bits are a geometric variable with probability 1-q^(2^k) of success.
+// Each Bernoulli(q^(2^i)) is generated by comparing a uniform number with the digits
+// of q^(2^i), which are computed to more precision whenever necessary.
+class geometric_distribution
+{
+  public:
+    using value_type = std::uint64_t;
+    using size_type = std::size_t;
+
+    geometric_distribution(std::uint64_t numerator, std::uint64_t denominator)
+        : m_numerator(numerator), m_denominator(denominator)
+    {
+        assert(0 < numerator && numerator <= denominator);
+        assert(denominator < (std::uint64_t(1) << 48));
+
+        // Choose k so that q^(2^k) <= 1/2, so the high part needs few draws
+        double q = 1.0 - double(numerator) / double(denominator);
+        while (q > 0.5 && m_levels < 62)
+        {
+            q *= q;
+            ++m_levels;
+        }
+
+        for (std::size_t i = 0; i <= m_levels; ++i)
+            m_powers.push_back(power_bounds(i, initial_digits));
+    }
+
+    explicit geometric_distribution(const bernoulli_distribution &dist)
+        : geometric_distribution(dist.numerator(), dist.denominator())
+    {
+    }
+
+    template <std::integral U, U M, U N>
+    explicit geometric_distribution(const const_bernoulli_distribution<U, M, N>) : geometric_distribution(M, N)
+    {
+    }
+
+    std::uint64_t numerator() const
+    {
+        return m_numerator;
+    }
+
+    std::uint64_t denominator() const
+    {
+        return m_denominator;
+    }
+
+    value_type min() const
+    {
+        return 0;
+    }
+
+    value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+    // The number of independently generated low bits
+    size_type levels() const
+    {
+        return m_levels;
+    }
+
+    // The j-th base 2^16 digit of q^(2^i)
+    std::uint32_t digit(size_type i, size_type j) const
+    {
+        auto &bounds = m_powers[i];
+        if (j < bounds.known_digits)
+            return bounds.lower[j];
+
+        // The digit is not yet known, so compute the bounds with more precision
+        for (auto precision = 2 * initial_digits;; precision *= 2)
+        {
+            auto refined = power_bounds(i, precision + j);
+            if (j < refined.known_digits)
+                return refined.lower[j];
+        }
+    }
+
+  private:
+    static constexpr size_type initial_digits = 4;
+
+    // Lower and upper bounds on q^(2^i). Digits are known where the bounds agree.
+    struct bounds
+    {
+        fixed_digits lower, upper;
+        size_type known_digits;
+    };
+
+    bounds power_bounds(size_type i, size_type precision) const
+    {
+        // Digits of q by long division
+        fixed_digits lower(precision), upper;
+        std::uint64_t r = m_denominator - m_numerator;
+        for (auto &d : lower)
+        {
+            r <<= 16;
+            d = r / m_denominator;
+            r %= m_denominator;
+        }
+        upper = lower;
+        if (r)
+        {
+            // q is not exact, so add one unit in the last place. q < 1 - 2^(-16 * precision), since
+            // the denominator is below 2^48, so this does not carry out of the first digit.
+            auto k = precision;
+            while (upper[k - 1] == 0xffff)
+                upper[--k] = 0;
+            ++upper[k - 1];
+        }
+
+        for (; i > 0; --i)
+        {
+            lower = multiply(lower, lower, false);
+            upper = multiply(upper, upper, true);
+        }
+
+        size_type known = 0;
+        while (known < precision && lower[known] == upper[known])
+            ++known;
+        return {std::move(lower), std::move(upper), known};
+    }
+
+    std::uint64_t m_numerator, m_denominator;
+    size_type m_levels = 0;
+    std::vector<bounds> m_powers;
+};
+
+template <std::integral uint_t>
+std::uint64_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                       const geometric_distribution &output_dist)
+{
+    // Bernoulli(q^(2^i))
+    auto power = [&](std::size_t i) {
+        return generate_expansion(U_s, s, N, fetch_entropy, [&](std::size_t j) { return output_dist.digit(i, j); });
+    };
+
+    auto k = output_dist.levels();
+    std::uint64_t result = 0;
+    while (power(k))
+        ++result;
+    result <<= k;
+
+    for (std::size_t i = 0; i < k; ++i)
+    {
+        // Bernoulli(x/(1+x)) from a fair coin and Bernoulli(x)
+        while (generate(U_s, s, N, fetch_entropy, binary_distribution{}))
+        {
+            if (power(i))
+            {
+                result |= std::uint64_t(1) << i;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+// The number of failures before the given number of successes
+class negative_binomial_distribution
+{
+  public:
+    using value_type = std::uint64_t;
+    using size_type = std::size_t;
+
+    negative_binomial_distribution(std::uint64_t successes, std::uint64_t numerator, std::uint64_t denominator)
+        : m_successes(successes), m_trial(numerator, denominator)
+    {
+    }
+
+    std::uint64_t successes() const
+    {
+        return m_successes;
+    }
+
+    const geometric_distribution &trial() const
+    {
+        return m_trial;
+    }
+
+    value_type min() const
+    {
+        return 0;
+    }
+
+    value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+  private:
+    std::uint64_t m_successes;
+    geometric_distribution m_trial;
+};
+
+template <std::integral uint_t>
+std::uint64_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                       const negative_binomial_distribution &output_dist)
+{
+    std::uint64_t result = 0;
+    for (std::uint64_t i = 0; i < output_dist.successes(); ++i)
+        result += generate(U_s, s, N, fetch_entropy, output_dist.trial());
+    return result;
+}
+
+// Writes the indexes in [0, n) of the successful trials out of n independent Bernoulli trials.
+// The cost is proportional to the number of successes, as each gap between successes is
+// generated with a single geometric variable.
+template <entropy_generator Source, std::integral Buffer, typename Instrumentation, typename RefillPolicy,
+          std::output_iterator<std::uint64_t> It>
+It bernoulli_select(entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &store, std::uint64_t n,
+                    const geometric_distribution &gaps, It out)
+{
+    for (std::uint64_t i = 0;; ++i)
+    {
+        auto gap = store(gaps);
+        if (gap >= n - i)
+            return out;
+        i += gap;
+        *out++ = i;
+    }
+}
+
+template <entropy_generator Source, std::integral Buffer, typename Instrumentation, typename RefillPolicy,
+          std::output_iterator<std::uint64_t> It>
+It bernoulli_select(entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &store, std::uint64_t n,
+                    const bernoulli_distribution &p, It out)
+{
+    return bernoulli_select(store, n, geometric_distribution{p}, out);
+}
+
+// Integers in [1, n] with probability proportional to 1/i^exponent, for exponent > 0.
+// Uses the rejection-inversion method of Hörmann and Derflinger, which needs O(1) memory
+// and a small expected number of iterations for any n and exponent, so n can be far too
+// large for a weighted_distribution. Each uniform variable is drawn from the store a byte at
+// a time, only until the candidate and its acceptance are the same across the interval of
+// values it could still take, so most attempts take one or two bytes. The result is exact
+// for the integral of 1/x^exponent as computed in double precision, which is accurate to
+// about 1e-15 relative error, rather than for the exact integral.
+class zipf_distribution
+{
+  public:
+    using value_type = std::uint64_t;
+    using size_type = std::uint64_t;
+
+    zipf_distribution(std::uint64_t n, double exponent) : m_n(n), m_exponent(exponent)
+    {
+        assert(n > 0 && exponent > 0);
+        m_h_integral_x1 = h_integral(1.5) - 1.0;
+        m_h_integral_n = h_integral(n + 0.5);
+        m_s = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    std::uint64_t n() const
+    {
+        return m_n;
+    }
+
+    double exponent() const
+    {
+        return m_exponent;
+    }
+
+    value_type min() const
+    {
+        return 1;
+    }
+
+    value_type max() const
+    {
+        return m_n;
+    }
+
+    // One iteration of rejection-inversion, given a uniform variable in [0,1). Returns the
+    // candidate and whether it is accepted. The candidate does not increase with the uniform
+    // variable, and for each candidate, acceptance does not become true as the variable increases.
+    std::pair<value_type, bool> candidate(double uniform) const
+    {
+        double u = m_h_integral_n + uniform * (m_h_integral_x1 - m_h_integral_n);
+        double x = h_integral_inverse(u);
+        auto k = value_type(x + 0.5);
+        k = std::clamp<value_type>(k, 1, m_n);
+        return {k, k - x <= m_s || u >= h_integral(k + 0.5) - h(double(k))};
+    }
+
+    // As candidate, returning 0 if the sample is rejected
+    value_type sample(double uniform) const
+    {
+        auto [k, accepted] = candidate(uniform);
+        return accepted ? k : 0;
+    }
+
+  private:
+    // h(x) = 1/x^exponent
+    double h(double x) const
+    {
+        return std::exp(-m_exponent * std::log(x));
+    }
+
+    // The integral of h, (x^(1-exponent) - 1)/(1-exponent), or log(x) when the exponent is 1
+    double h_integral(double x) const
+    {
+        double log_x = std::log(x);
+        return expm1_over_x((1.0 - m_exponent) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        double t = x * (1.0 - m_exponent);
+        if (t < -1.0)
+            t = -1.0;
+        return std::exp(log1p_over_x(t) * x);
+    }
+
+    // log(1+x)/x, accurate near 0
+    static double log1p_over_x(double x)
+    {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // (exp(x)-1)/x, accurate near 0
+    static double expm1_over_x(double x)
+    {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    std::uint64_t m_n;
+    double m_exponent;
+    double m_h_integral_x1, m_h_integral_n, m_s;
+};
+
+template <std::integral uint_t>
+std::uint64_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                       const zipf_distribution &output_dist)
+{
+    for (;;)
+    {
+        // The uniform variable is in [lower, lower + 2^-bits), where both ends give the same
+        // result unless the variable is close to where the candidate or its acceptance changes
+        std::uint64_t lower = 0;
+        for (int bits = 8;; bits += 8)
+        {
+            uint_t digit;
+            std::tie(U_s, s, digit) = generate_const_uniform<256>(U_s, s, N, fetch_entropy);
+            lower = lower << 8 | digit;
+            auto result = output_dist.candidate(std::ldexp(double(lower), -bits));
+            // Beyond 64 bits, the ends round to the same double
+            if (bits == 64 || result == output_dist.candidate(std::ldexp(double(lower + 1), -bits)))
+            {
+                if (result.second)
+                    return result.first;
+                break;
+            }
+        }
+    }
+}
+
+// Generates a Bernoulli variable that is 1 with probability numerator/denominator, for any
+// 64-bit numerator <= denominator, even when the denominator is too large for the store.
+template <std::integral uint_t>
+uint_t generate_ratio(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                      std::uint64_t numerator, std::uint64_t denominator)
+{
+    assert(numerator <= denominator);
+    if (numerator == 0 || numerator == denominator)
+        return numerator != 0;
+    if (denominator <= N)
+        return generate(U_s, s, N, fetch_entropy, bernoulli_distribution{numerator, denominator});
+
+    // Binary long division, avoiding overflow of 2r
+    std::uint64_t r = numerator;
+    return generate_expansion(U_s, s, N, fetch_entropy, [&](std::size_t) {
+        std::uint32_t digit = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            bool bit = r >= denominator - r;
+            r = bit ? r - (denominator - r) : r + r;
+            digit = (digit << 1) | bit;
+        }
+        return digit;
+    });
+}
+
+// 1 with probability numerator/denominator, for 64-bit denominators that may not fit in the store.
+// Denominators that fit are generated as a bernoulli_distribution, and larger ones by binary
+// expansion.
+class large_bernoulli_distribution
+{
+  public:
+    using value_type = std::uint32_t;
+
+    large_bernoulli_distribution(std::uint64_t numerator, std::uint64_t denominator)
+        : m_numerator(numerator), m_denominator(denominator)
+    {
+        assert(numerator <= denominator && denominator > 0);
+    }
+
+    std::uint64_t numerator() const
+    {
+        return m_numerator;
+    }
+
+    std::uint64_t denominator() const
+    {
+        return m_denominator;
+    }
+
+    constexpr value_type min() const
+    {
+        return 0;
+    }
+
+    constexpr value_type max() const
+    {
+        return 1;
+    }
+
+  private:
+    std::uint64_t m_numerator, m_denominator;
+};
+
+template <std::integral uint_t>
+uint_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                const large_bernoulli_distribution &output_dist)
+{
+    return generate_ratio(U_s, s, N, fetch_entropy, output_dist.numerator(), output_dist.denominator());
+}
+
+// Generates a Bernoulli variable that is 1 with probability exp(-numerator/denominator),
+// for numerator <= denominator (Canonne, Kamath and Steinke, Algorithm 1)
+template <std::integral uint_t>
+uint_t generate_exp_minus(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                          std::uint64_t numerator, std::uint64_t denominator)
+{
+    assert(numerator <= denominator);
+    std::uint64_t k = 1;
+    // Bernoulli(gamma/k) as Bernoulli(1/k) and Bernoulli(gamma)
+    while ((k == 1 || generate(U_s, s, N, fetch_entropy, bernoulli_distribution{1, k})) &&
+           generate_ratio(U_s, s, N, fetch_entropy, numerator, denominator))
+        ++k;
+    return k % 2;
+}
+
+// The 128-bit product of two 64-bit numbers, as {high, low}
+inline std::pair<std::uint64_t, std::uint64_t> multiply_wide(std::uint64_t a, std::uint64_t b)
+{
+    std::uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32, b_lo = b & 0xffffffff, b_hi = b >> 32;
+    std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    return {hi_hi + (hi_lo >> 32) + (cross >> 32), (cross << 32) | (lo_lo & 0xffffffff)};
+}
+
+// a*b mod m, for m < 2^63
+inline std::uint64_t multiply_mod(std::uint64_t a, std::uint64_t b, std::uint64_t m)
+{
+    std::uint64_t r = 0;
+    for (a %= m; b; b >>= 1)
+    {
+        if (b & 1)
+            r = (r + a) % m;
+        a = (a + a) % m;
+    }
+    return r;
+}
+
+// Generates a Bernoulli variable that is 1 with probability exp(-x^2/denominator),
+// where x^2 may not fit in 64 bits. The integer part of the exponent is generated as
+// repeated Bernoulli(exp(-1)), which usually fails long before x^2/denominator iterations.
+template <std::integral uint_t>
+uint_t generate_exp_minus_square(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                                 std::uint64_t x, std::uint64_t denominator)
+{
+    assert(denominator < (std::uint64_t(1) << 63));
+    auto x2 = multiply_wide(x, x);
+    for (std::uint64_t c = 1; multiply_wide(c, denominator) <= x2; ++c)
+        if (!generate_exp_minus(U_s, s, N, fetch_entropy, 1, 1))
+            return 0;
+    return generate_exp_minus(U_s, s, N, fetch_entropy, multiply_mod(x, x, denominator), denominator);
+}
+
+// Integers with probability proportional to exp(-(i-center)^2/(2 sigma^2)), for an integer sigma
+// and a rational center. Samples are exact, using the algorithm of Canonne, Kamath and Steinke:
+// a discrete Laplace proposal with scale t = sigma+1 is accepted with a Bernoulli(exp(-gamma)),
+// where gamma is rational. All of the Bernoulli variables come from the store.
+// A fractional center f is handled by adjusting the acceptance exponent, which is
+// (y - f - sigma^2/t)^2/(2 sigma^2) for y >= 0 and (y - f + sigma^2/t)^2/(2 sigma^2) + 2f/t
+// for y < 0.
+// The exponents' denominators 2 sigma^2 t^2 d^2 must be less than 2^63, where d is the
+// center's denominator.
+class discrete_gaussian_distribution
+{
+  public:
+    using value_type = std::int64_t;
+    using size_type = std::uint64_t;
+
+    discrete_gaussian_distribution(std::uint32_t sigma, std::int64_t center_numerator = 0,
+                                   std::uint64_t center_denominator = 1)
+        : m_sigma(sigma), m_center_numerator(center_numerator), m_center_denominator(center_denominator)
+    {
+        assert(sigma > 0 && center_denominator > 0);
+        m_scale = sigma + 1;
+
+        // Split the center into its integer and fractional parts
+        auto d = std::int64_t(center_denominator);
+        m_offset = center_numerator / d;
+        if (center_numerator % d < 0)
+            --m_offset;
+        m_fraction = std::uint64_t(center_numerator - m_offset * d);
+
+        std::uint64_t sigma2 = std::uint64_t(sigma) * sigma;
+        assert(2.0 * double(sigma2) * double(m_scale) * double(m_scale) * double(d) * double(d) < 0x1p63);
+        m_sigma2_d = sigma2 * center_denominator;
+        m_scale_d = m_scale * center_denominator;
+        m_gamma_denominator = 2 * sigma2 * m_scale_d * m_scale_d;
+    }
+
+    std::uint32_t sigma() const
+    {
+        return m_sigma;
+    }
+
+    std::int64_t center_numerator() const
+    {
+        return m_center_numerator;
+    }
+
+    std::uint64_t center_denominator() const
+    {
+        return m_center_denominator;
+    }
+
+    value_type min() const
+    {
+        return std::numeric_limits<value_type>::min();
+    }
+
+    value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+    // The scale of the discrete Laplace proposal
+    std::uint64_t scale() const
+    {
+        return m_scale;
+    }
+
+    // The integer part of the center
+    std::int64_t offset() const
+    {
+        return m_offset;
+    }
+
+    // The acceptance exponent for a proposal y around the integer part of the center, as
+    // x^2/gamma_denominator(), plus 2f/t for negative y, which is given by fraction_exponent()
+    std::uint64_t gamma_x(std::int64_t y) const
+    {
+        std::int64_t x = y * std::int64_t(m_scale_d) - std::int64_t(m_fraction * m_scale) +
+                         (y < 0 ? std::int64_t(m_sigma2_d) : -std::int64_t(m_sigma2_d));
+        return x < 0 ? -x : x;
+    }
+
+    std::uint64_t gamma_denominator() const
+    {
+        return m_gamma_denominator;
+    }
+
+    // 2f/t as {numerator, denominator}
+    std::pair<std::uint64_t, std::uint64_t> fraction_exponent() const
+    {
+        return {2 * m_fraction, m_scale_d};
+    }
+
+  private:
+    std::uint32_t m_sigma;
+    std::int64_t m_center_numerator;
+    std::uint64_t m_center_denominator;
+    std::uint64_t m_scale;
+    std::int64_t m_offset;
+    std::uint64_t m_fraction, m_sigma2_d, m_scale_d, m_gamma_denominator;
+};
+
+template <std::integral uint_t>
+std::int64_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                      const discrete_gaussian_distribution &output_dist)
+{
+    auto t = output_dist.scale();
+    for (;;)
+    {
+        // Discrete Laplace with scale t (Canonne, Kamath and Steinke, Algorithm 2)
+        uint_t u;
+        std::tie(U_s, s, u) = generate_uniform(U_s, s, N, uint_t(t), fetch_entropy);
+        if (!generate_exp_minus(U_s, s, N, fetch_entropy, u, t))
+            continue;
+        std::uint64_t v = 0;
+        while (generate_exp_minus(U_s, s, N, fetch_entropy, 1, 1))
+            ++v;
+        auto x = std::int64_t(u + t * v);
+        auto negative = generate(U_s, s, N, fetch_entropy, binary_distribution{});
+        if (negative && x == 0)
+            continue;
+        auto y = negative ? -x : x;
+
+        // Accept with probability exp(-gamma)
+        if (y < 0)
+        {
+            auto [numerator, denominator] = output_dist.fraction_exponent();
+            if (!generate_exp_minus(U_s, s, N, fetch_entropy, numerator, denominator))
+                continue;
+        }
+        if (generate_exp_minus_square(U_s, s, N, fetch_entropy, output_dist.gamma_x(y), output_dist.gamma_denominator()))
+            return output_dist.offset() + y;
+    }
+}
+
+// Fills a span with samples
+template <std::integral uint_t>
+void generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+              const discrete_gaussian_distribution &output_dist, std::span<std::int64_t> out)
+{
+    for (auto &y : out)
+        y = generate(U_s, s, N, fetch_entropy, output_dist);
+}
+
+// A discrete Gaussian with an integer center, sampled by scanning a cumulative distribution
+// table (CDT) in full, so the number of operations does not depend on the output.
+// Probabilities are rounded to 64 bits and the tails beyond 13 sigma are cut, so unlike
+// discrete_gaussian_distribution this is not exact. Only the table scan is constant-time:
+// the store's own refills still depend on the entropy consumed.
+class cdt_gaussian_distribution
+{
+  public:
+    using value_type = std::int64_t;
+    using size_type = std::uint64_t;
+
+    static constexpr int tail_cut = 13;
+
+    explicit cdt_gaussian_distribution(std::uint32_t sigma, std::int64_t center = 0)
+        : m_sigma(sigma), m_center(center)
+    {
+        assert(sigma > 0);
+        m_bound = std::int64_t(tail_cut) * sigma;
+        std::vector<long double> weights;
+        long double total = 0;
+        for (auto i = -m_bound; i <= m_bound; ++i)
+        {
+            weights.push_back(std::exp(-(long double)(i) * i / (2.0L * sigma * sigma)));
+            total += weights.back();
+        }
+
+        // The table holds the cumulative probabilities, scaled to 2^64
+        long double cumulative = 0;
+        for (std::size_t i = 0; i + 1 < weights.size(); ++i)
+        {
+            cumulative += weights[i];
+            m_cumulative.push_back(std::uint64_t(std::min(cumulative / total * 0x1p64L, 0x1p64L - 1)));
+        }
+    }
+
+    std::uint32_t sigma() const
+    {
+        return m_sigma;
+    }
+
+    std::int64_t center() const
+    {
+        return m_center;
+    }
+
+    value_type min() const
+    {
+        return m_center - m_bound;
+    }
+
+    value_type max() const
+    {
+        return m_center + m_bound;
+    }
+
+    std::span<const std::uint64_t> cumulative() const
+    {
+        return m_cumulative;
+    }
+
+  private:
+    std::uint32_t m_sigma;
+    std::int64_t m_center, m_bound;
+    std::vector<std::uint64_t> m_cumulative;
+};
+
+template <std::integral uint_t>
+std::int64_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                      const cdt_gaussian_distribution &output_dist)
+{
+    std::uint64_t u = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        uint_t digit;
+        std::tie(U_s, s, digit) = generate_const_uniform<1 << 16>(U_s, s, N, fetch_entropy);
+        u = (u << 16) | digit;
+    }
+
+    // Count the entries below u, without branching on them
+    std::int64_t index = 0;
+    for (auto c : output_dist.cumulative())
+        index += c <= u;
+    return output_dist.min() + index;
+}
+
+template <std::integral uint_t>
+void generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+              const cdt_gaussian_distribution &output_dist, std::span<std::int64_t> out)
+{
+    for (auto &y : out)
+        y = generate(U_s, s, N, fetch_entropy, output_dist);
+}
+
+// Keeps a uniform random sample of k records from a stream of unknown length.
+// Instead of drawing a random number for every record, the sampler draws the number of
+// records to skip before the next record is kept, so skipped records cost no entropy and
+// can be discarded without being read. After t records, record t+j is kept with probability
+// k/(t+j). Candidates are drawn with geometric gaps with probability k/(t+1) of success, and
+// each candidate is then kept with probability (t+1)/(t+j), which makes the skips exact.
+// The skips are heavy-tailed, so t+j often exceeds the store's range even in short streams, and
+// the candidate is then kept by binary expansion. Streams are limited to 2^48 records by
+// geometric_distribution.
+template <typename T> class reservoir_sampler
+{
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    explicit reservoir_sampler(size_type k) : m_k(k)
+    {
+        assert(k > 0);
+        m_samples.reserve(k);
+    }
+
+    // Adds the next record of the stream, and returns true if it was kept
+    template <entropy_generator Source, std::integral Buffer, typename Instrumentation, typename RefillPolicy,
+              typename U>
+    bool push(entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &store, U &&record)
+    {
+        ++m_count;
+        if (m_samples.size() < m_k)
+        {
+            m_samples.push_back(std::forward<U>(record));
+            if (m_samples.size() == m_k)
+                schedule(store);
+            return true;
+        }
+
+        if (m_skip > 0)
+        {
+            --m_skip;
+            return false;
+        }
+
+        m_samples[store(uniform_distribution<size_type>{0, m_k - 1})] = std::forward<U>(record);
+        schedule(store);
+        return true;
+    }
+
+    // The number of records that will be discarded before the next record is kept
+    std::uint64_t skip() const
+    {
+        return m_skip;
+    }
+
+    // Discards records without reading them. n must not exceed skip().
+    void discard(std::uint64_t n)
+    {
+        assert(n <= m_skip);
+        m_skip -= n;
+        m_count += n;
+    }
+
+    // The number of records seen so far
+    std::uint64_t count() const
+    {
+        return m_count;
+    }
+
+    size_type capacity() const
+    {
+        return m_k;
+    }
+
+    std::span<const T> samples() const
+    {
+        return m_samples;
+    }
+
+  private:
+    template <entropy_generator Source, std::integral Buffer, typename Instrumentation, typename RefillPolicy>
+    void schedule(entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &store)
+    {
+        std::uint64_t t = m_count, j = 0;
+        const geometric_distribution gaps{m_k, t + 1};
+        for (;;)
+        {
+            j += store(gaps) + 1;
+            if (j == 1 || store(large_bernoulli_distribution{t + 1, t + j}))
+                break;
+        }
+        m_skip = j - 1;
+    }
+
+    size_type m_k;
+    std::uint64_t m_count = 0, m_skip = 0;
+    std::vector<T> m_samples;
+};
+
+// Base-K digits mapped to characters, for generating decimal or alphanumeric tokens in bulk.
+// Generating into a span takes the largest power of K that keeps the rejection rate low, as
+// uniform_tuple does, so one draw yields many digits. The default alphabet is the first K of
+// 0-9, a-z, A-Z.
+template <std::uint32_t K> class digit_stream
+{
+    static_assert(K >= 2 && K <= 256, "Invalid digit base");
+
+  public:
+    using value_type = char;
+
+    static constexpr std::string_view default_alphabet =
+        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    digit_stream(std::string_view alphabet = default_alphabet.substr(0, std::min<std::size_t>(K, 62)))
+    {
+        assert(alphabet.size() == K);
+        std::copy(alphabet.begin(), alphabet.end(), m_alphabet.begin());
+    }
+
+    const std::array<char, K> &alphabet() const
+    {
+        return m_alphabet;
+    }
+
+    // The digit values, before they are mapped to characters
+    constexpr std::uint32_t min() const
+    {
+        return 0;
+    }
+    constexpr std::uint32_t max() const
+    {
+        return K - 1;
+    }
+
+  private:
+    std::array<char, K> m_alphabet;
+};
+
+template <std::integral uint_t, std::uint32_t K>
+char generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+              const digit_stream<K> &output_dist)
+{
+    uint_t U_n;
+    std::tie(U_s, s, U_n) = generate_const_uniform<K>(U_s, s, N, fetch_entropy);
+    return output_dist.alphabet()[U_n];
+}
+
+// Fills a span with digits
+template <std::integral uint_t, std::uint32_t K>
+void generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+              const digit_stream<K> &output_dist, std::span<char> out)
+{
+    const uint_t max_group = N >> 8;
+    uint_t group = K;
+    std::size_t digits = 1;
+    while (group <= max_group / K)
+    {
+        group *= K;
+        ++digits;
+    }
+
+    auto &alphabet = output_dist.alphabet();
+    auto next = out.begin();
+    while (next != out.end())
+    {
+        // The last group may be shorter
+        if (std::size_t(out.end() - next) < digits)
+        {
+            digits = out.end() - next;
+            group = 1;
+            for (std::size_t j = 0; j < digits; ++j)
+                group *= K;
+        }
+        uint_t k, U_n;
+        std::tie(U_s, s, k) = generate_multiple(U_s, s, N, group, fetch_entropy);
+        std::tie(U_s, s, U_n) = divide(U_s, s, group);
+        for (std::size_t j = 0; j < digits; ++j)
+        {
+            *next++ = alphabet[U_n % K];
+            U_n /= K;
+        }
+    }
+}
+
+} // namespace entropy_store
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "entropy_distributions.hpp"
 #include "entropy_store.hpp"
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <numbers>
+#include <vector>
 
 namespace entropy_store
 {
@@ -34,12 +37,12 @@ template <std::integral T, T Min, T Max> double entropy(const const_uniform_dist
     return std::log2(dist.size());
 }
 
-inline double P(const weighted_distribution &dist, int i)
+double P(const weighted_table auto &dist, int i)
 {
     return double(dist.weights()[i]) / dist.outputs().size();
 }
 
-inline double entropy(const weighted_distribution &dist)
+double entropy(const weighted_table auto &dist)
 {
     double h = 0;
     for (double w : dist.weights())
@@ -80,6 +83,166 @@ double entropy(const const_bernoulli_distribution<uint_t, M, N> &dist)
     return -p * std::log2(p) - (1 - p) * std::log2(1 - p);
 }
 
+inline double P(const dice_sum_distribution &dist, int i)
+{
+    return dist.probability(i);
+}
+
+inline double entropy(const dice_sum_distribution &dist)
+{
+    double h = 0;
+    for (int i = dist.min(); i <= dist.max(); ++i)
+    {
+        auto p = dist.probability(i);
+        if (p > 0)
+            h -= p * std::log2(p);
+    }
+    return h;
+}
+
+// Only practical for small n
+inline double P(const zipf_distribution &dist, int i)
+{
+    double total = 0;
+    for (std::uint64_t j = 1; j <= dist.n(); ++j)
+        total += std::pow(double(j), -dist.exponent());
+    return i >= 1 && std::uint64_t(i) <= dist.n() ? std::pow(double(i), -dist.exponent()) / total : 0;
+}
+
+// Sums the first 2^20 terms, and approximates the rest by integrals
+inline double entropy(const zipf_distribution &dist)
+{
+    // -log p_i = exponent * log i + log total, where total is the sum of i^-exponent
+    const double exponent = dist.exponent();
+    const std::uint64_t terms = std::min<std::uint64_t>(dist.n(), 1 << 20);
+    double total = 0, log_total = 0;
+    for (std::uint64_t i = 1; i <= terms; ++i)
+    {
+        double w = std::pow(double(i), -exponent);
+        total += w;
+        log_total += w * std::log(double(i));
+    }
+    if (dist.n() > terms)
+    {
+        // The integrals of x^-exponent and x^-exponent log x
+        auto integral = [&](double x) {
+            return exponent == 1 ? std::log(x) : std::pow(x, 1 - exponent) / (1 - exponent);
+        };
+        auto log_integral = [&](double x) {
+            return exponent == 1 ? std::log(x) * std::log(x) / 2
+                                 : std::pow(x, 1 - exponent) * (std::log(x) / (1 - exponent) -
+                                                                1 / ((1 - exponent) * (1 - exponent)));
+        };
+        double a = terms + 0.5, b = dist.n() + 0.5;
+        total += integral(b) - integral(a);
+        log_total += log_integral(b) - log_integral(a);
+    }
+    return (std::log(total) + exponent * log_total / total) / std::log(2.0);
+}
+
+inline double P(const discrete_gaussian_distribution &dist, std::int64_t i)
+{
+    double center = double(dist.center_numerator()) / dist.center_denominator();
+    double sigma = dist.sigma(), total = 0;
+    auto weight = [&](std::int64_t j) { return std::exp(-(j - center) * (j - center) / (2 * sigma * sigma)); };
+    for (auto j = std::int64_t(center - 40 * sigma); j <= std::int64_t(center + 40 * sigma); ++j)
+        total += weight(j);
+    return weight(i) / total;
+}
+
+// Sums over 40 sigma either side of the center
+inline double entropy(const discrete_gaussian_distribution &dist)
+{
+    double center = double(dist.center_numerator()) / dist.center_denominator();
+    double sigma = dist.sigma(), total = 0, h = 0;
+    std::vector<double> weights;
+    for (auto j = std::int64_t(center - 40 * sigma); j <= std::int64_t(center + 40 * sigma); ++j)
+    {
+        weights.push_back(std::exp(-(j - center) * (j - center) / (2 * sigma * sigma)));
+        total += weights.back();
+    }
+    for (auto w : weights)
+        if (auto p = w / total; p > 0)
+            h -= p * std::log2(p);
+    return h;
+}
+
+inline double entropy(const cdt_gaussian_distribution &dist)
+{
+    double h = 0;
+    std::uint64_t previous = 0;
+    auto add = [&](double p) {
+        if (p > 0)
+            h -= p * std::log2(p);
+    };
+    for (auto c : dist.cumulative())
+    {
+        add(std::ldexp(double(c - previous), -64));
+        previous = c;
+    }
+    add(1 - std::ldexp(double(previous), -64));
+    return h;
+}
+
+inline double P(const geometric_distribution &dist, int i)
+{
+    double p = double(dist.numerator()) / double(dist.denominator());
+    return std::pow(1 - p, i) * p;
+}
+
+inline double entropy(const large_bernoulli_distribution &dist)
+{
+    double p = double(dist.numerator()) / double(dist.denominator());
+    return p > 0 && p < 1 ? -p * std::log2(p) - (1 - p) * std::log2(1 - p) : 0;
+}
+
+inline double entropy(const geometric_distribution &dist)
+{
+    double p = double(dist.numerator()) / double(dist.denominator());
+    return p < 1 ? (-p * std::log2(p) - (1 - p) * std::log2(1 - p)) / p : 0;
+}
+
+// Sums the probabilities until all but 1e-12 of the distribution is counted, or uses the normal
+// approximation when that would take more than 10^7 terms
+inline double entropy(const negative_binomial_distribution &dist)
+{
+    double p = double(dist.trial().numerator()) / double(dist.trial().denominator());
+    double r = double(dist.successes());
+    if (p == 1 || r == 0)
+        return 0;
+    double variance = r * (1 - p) / (p * p);
+    if (r * (1 - p) / p + 40 * std::sqrt(variance) > 1e7)
+        return 0.5 * std::log2(2 * std::numbers::pi * std::numbers::e * variance);
+    // log P(k) = log C(k+r-1, k) + r log p + k log(1-p)
+    double log_p = r * std::log(p), covered = 0, h = 0;
+    for (double k = 0; covered < 1 - 1e-12 && k < 1e7; ++k)
+    {
+        double q = std::exp(log_p);
+        covered += q;
+        h -= q * log_p;
+        log_p += std::log1p(-p) + std::log((k + r) / (k + 1));
+    }
+    return h / std::log(2.0);
+}
+
+template <distribution... Distributions> double entropy(const product_distribution<Distributions...> &dist)
+{
+    return std::apply([](const auto &...dists) { return (0.0 + ... + entropy(dists)); }, dist.components());
+}
+
+template <std::integral T> double entropy(const uniform_tuple<T> &dist)
+{
+    double h = 0;
+    for (auto &c : dist.components())
+        h += entropy(c);
+    return h;
+}
+
+template <std::uint32_t K> double entropy(const digit_stream<K> &)
+{
+    return std::log2(double(K));
+}
+
 template <entropy_generator Source> struct counter
 {
     using source_type = Source;
@@ -143,8 +306,8 @@ template <typename Source> std::size_t bits_fetched(const counter<Source> &sourc
     return source.m_count;
 }
 
-template <entropy_generator Source, std::integral Buffer = std::uint32_t>
-double internal_entropy(const entropy_store<Source, Buffer> &es)
+template <entropy_generator Source, std::integral Buffer, typename Instrumentation, typename RefillPolicy>
+double internal_entropy(const entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &es)
 {
     return std::log2(es.size()) + internal_entropy(es.source());
 }
@@ -161,7 +324,8 @@ std::size_t bits_fetched(const entropy_converter<Source, Distribution, Buffer> &
     return bits_fetched(source.source());
 }
 
-template <typename Source, typename Buffer> std::size_t bits_fetched(const entropy_store<Source, Buffer> &source)
+template <typename Source, typename Buffer, typename Instrumentation, typename RefillPolicy>
+std::size_t bits_fetched(const entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &source)
 {
     return bits_fetched(source.source());
 }
@@ -176,6 +340,22 @@ template <typename Source> inline std::size_t internal_entropy(const bit_generat
     return 0;
 }
 
+template <typename Source, int Bits> inline std::size_t internal_entropy(const chunk_generator<Source, Bits> &)
+{
+    return 0;
+}
+
+// Reserved values have been fetched but not yet used
+template <typename Source> double internal_entropy(const reserved_source<Source> &source)
+{
+    return source.reserved() * std::log2(double(source.distribution().size())) + internal_entropy(source.source());
+}
+
+template <typename Source> std::size_t bits_fetched(const reserved_source<Source> &source)
+{
+    return bits_fetched(source.source());
+}
+
 void mean_and_sd(const distribution auto &dist, int sample, double total, double &mean, double &sd)
 {
     auto w = P(dist, sample);
@@ -202,7 +382,7 @@ template <entropy_generator Source> class check_distribution
     check_distribution(Source source) : m_source(std::move(source))
     {
         m_counts.resize(distribution().max() + 1, 0);
-        m_pair_counts.resize(distribution().max() + 1, m_counts);
+        m_pair_counts.resize(m_counts.size() * m_counts.size(), 0);
     }
 
     auto operator()()
@@ -210,7 +390,7 @@ template <entropy_generator Source> class check_distribution
         auto value = m_source();
         ++m_counts[value];
         if (m_previous != -1)
-            ++m_pair_counts[m_previous][value];
+            ++m_pair_counts[m_previous * m_counts.size() + value];
         m_previous = value;
         ++m_count;
         return value;
@@ -293,7 +473,7 @@ template <entropy_generator Source> class check_distribution
         {
             for (auto j = 0; j < m_counts.size(); ++j)
             {
-                auto s = m_pair_counts[i][j];
+                auto s = m_pair_counts[i * m_counts.size() + j];
                 if (s > 0)
                 {
                     double mean, sd;
@@ -315,7 +495,8 @@ template <entropy_generator Source> class check_distribution
     Source m_source;
 
     std::vector<size_type> m_counts;
-    std::vector<std::vector<size_type>> m_pair_counts;
+    // Counts of each value i followed by j, at i * m_counts.size() + j
+    std::vector<size_type> m_pair_counts;
     size_type m_count = 0;
 };
 
@@ -365,7 +546,7 @@ std::ostream &operator<<(std::ostream &os, const const_bernoulli_distribution<ui
     return os << "Bernoulli{" << b.numerator() << "/" << b.denominator() << "}";
 }
 
-inline std::ostream &operator<<(std::ostream &os, const weighted_distribution &w)
+std::ostream &operator<<(std::ostream &os, const weighted_table auto &w)
 {
     bool first = true;
     auto comma = [&]() {
@@ -382,6 +563,41 @@ inline std::ostream &operator<<(std::ostream &os, const weighted_distribution &w
     return os << "}";
 }
 
+inline std::ostream &operator<<(std::ostream &os, const zipf_distribution &z)
+{
+    return os << "Zipf{" << z.n() << "," << z.exponent() << "}";
+}
+
+inline std::ostream &operator<<(std::ostream &os, const discrete_gaussian_distribution &g)
+{
+    return os << "DiscreteGaussian{" << g.sigma() << "," << g.center_numerator() << "/" << g.center_denominator()
+              << "}";
+}
+
+inline std::ostream &operator<<(std::ostream &os, const cdt_gaussian_distribution &g)
+{
+    return os << "CDTGaussian{" << g.sigma() << "," << g.center() << "}";
+}
+
+inline std::ostream &operator<<(std::ostream &os, const geometric_distribution &g)
+{
+    return os << "Geometric{" << g.numerator() << "/" << g.denominator() << "}";
+}
+
+inline std::ostream &operator<<(std::ostream &os, const negative_binomial_distribution &nb)
+{
+    return os << "NegativeBinomial{" << nb.successes() << "," << nb.trial().numerator() << "/"
+              << nb.trial().denominator() << "}";
+}
+
+inline std::ostream &operator<<(std::ostream &os, const dice_sum_distribution &d)
+{
+    os << "DiceSum{" << d.count() << "d" << d.sides();
+    if (d.offset())
+        os << std::showpos << d.offset() << std::noshowpos;
+    return os << "}";
+}
+
 template <typename Source> double internal_entropy(const check_distribution<Source> &source)
 {
     return internal_entropy(source.source());
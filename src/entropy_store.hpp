@@ -1,9 +1,23 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <limits>
+#include <memory>
 #include <random>
 #include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
 #include <vector>
 
 namespace entropy_store
@@ -157,6 +171,13 @@ class bernoulli_distribution
 
 template <std::uint32_t M, std::uint32_t N> using const_bernoulli = const_bernoulli_distribution<std::uint32_t, M, N>;
 
+// A new id for a table of weights, unique within the process
+inline std::uint64_t next_table_id()
+{
+    static std::atomic<std::uint64_t> ids = 0;
+    return ids.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 // Contains the lookup tables for a weighted distribution
 class weighted_distribution
 {
@@ -215,8 +236,320 @@ class weighted_distribution
         return m_weights.size() - 1;
     }
 
+    // Identifies the tables without comparing them. Copies share the id of the original.
+    std::uint64_t id() const
+    {
+        return m_id;
+    }
+
   private:
     std::vector<value_type> m_weights, m_outputs, m_offsets;
+    std::uint64_t m_id = next_table_id();
+};
+
+// Any distribution that exposes the lookup tables of a weighted_distribution
+template <typename Distribution>
+concept weighted_table = distribution<Distribution> && requires(const Distribution &dist) {
+    dist.weights();
+    dist.outputs();
+    dist.offsets();
+};
+
+// A non-owning reference to the lookup tables of a weighted_distribution,
+// which must outlive the view. Copying a view only copies a pointer.
+class weighted_view
+{
+  public:
+    using value_type = weighted_distribution::value_type;
+    using size_type = weighted_distribution::size_type;
+
+    weighted_view(const weighted_distribution &dist) : m_table(&dist)
+    {
+    }
+
+    // A view of a temporary would dangle
+    weighted_view(weighted_distribution &&) = delete;
+
+    std::span<const value_type> weights() const
+    {
+        return m_table->weights();
+    }
+    std::span<const value_type> outputs() const
+    {
+        return m_table->outputs();
+    }
+    std::span<const value_type> offsets() const
+    {
+        return m_table->offsets();
+    }
+
+    value_type min() const
+    {
+        return m_table->min();
+    }
+
+    value_type max() const
+    {
+        return m_table->max();
+    }
+
+    std::uint64_t id() const
+    {
+        return m_table->id();
+    }
+
+  private:
+    const weighted_distribution *m_table;
+};
+
+// An immutable weighted distribution whose lookup tables are reference-counted,
+// so that copies share the same tables.
+class shared_weighted_distribution
+{
+  public:
+    using value_type = weighted_distribution::value_type;
+    using size_type = weighted_distribution::size_type;
+
+    shared_weighted_distribution(weighted_distribution dist)
+        : m_table(std::make_shared<const weighted_distribution>(std::move(dist)))
+    {
+    }
+
+    std::span<const value_type> weights() const
+    {
+        return m_table->weights();
+    }
+    std::span<const value_type> outputs() const
+    {
+        return m_table->outputs();
+    }
+    std::span<const value_type> offsets() const
+    {
+        return m_table->offsets();
+    }
+
+    value_type min() const
+    {
+        return m_table->min();
+    }
+
+    value_type max() const
+    {
+        return m_table->max();
+    }
+
+    std::uint64_t id() const
+    {
+        return m_table->id();
+    }
+
+    operator weighted_view() const &
+    {
+        return *m_table;
+    }
+
+    // A temporary may hold the last reference to the tables, so its view would dangle
+    operator weighted_view() const && = delete;
+
+  private:
+    std::shared_ptr<const weighted_distribution> m_table;
+};
+
+// One row of a weighted_table_set, with the same lookup tables as a weighted_distribution
+class weighted_row
+{
+  public:
+    using value_type = weighted_distribution::value_type;
+    using size_type = weighted_distribution::size_type;
+
+    weighted_row(std::span<const value_type> weights, std::span<const value_type> outputs,
+                 std::span<const value_type> offsets)
+        : m_weights(weights), m_outputs(outputs), m_offsets(offsets)
+    {
+    }
+
+    std::span<const value_type> weights() const
+    {
+        return m_weights;
+    }
+    std::span<const value_type> outputs() const
+    {
+        return m_outputs;
+    }
+    std::span<const value_type> offsets() const
+    {
+        return m_offsets;
+    }
+
+    value_type min() const
+    {
+        return 0;
+    }
+
+    value_type max() const
+    {
+        return m_weights.size() - 1;
+    }
+
+  private:
+    std::span<const value_type> m_weights, m_outputs, m_offsets;
+};
+
+// Many small weighted distributions (for example the transition tables of a Markov chain)
+// packed into one arena. Each row is stored like a weighted_distribution, but all rows
+// share the same three vectors, indexed by the row's start positions.
+class weighted_table_set
+{
+  public:
+    using value_type = weighted_distribution::value_type;
+    using size_type = weighted_distribution::size_type;
+
+    weighted_table_set()
+    {
+        m_rows.push_back({0, 0});
+    }
+
+    // Appends a row and returns its index
+    size_type add(std::span<const value_type> weights)
+    {
+        for (auto w : weights)
+        {
+            m_offsets.push_back(m_outputs.size() - m_rows.back().outputs);
+            m_weights.push_back(w);
+            for (int j = 0; j < w; ++j)
+                m_outputs.push_back(m_weights.size() - 1 - m_rows.back().weights);
+        }
+        if (weights.size() > m_max_size)
+            m_max_size = weights.size();
+        m_rows.push_back({value_type(m_weights.size()), value_type(m_outputs.size())});
+        // Copies of the set may add different rows from here on
+        m_id = next_table_id();
+        return size() - 1;
+    }
+
+    size_type add(std::initializer_list<value_type> weights)
+    {
+        return add(std::span{weights.begin(), weights.size()});
+    }
+
+    size_type size() const
+    {
+        return m_rows.size() - 1;
+    }
+
+    weighted_row operator[](size_type i) const
+    {
+        auto &row = m_rows[i], &next = m_rows[i + 1];
+        return {std::span{m_weights}.subspan(row.weights, next.weights - row.weights),
+                std::span{m_outputs}.subspan(row.outputs, next.outputs - row.outputs),
+                std::span{m_offsets}.subspan(row.weights, next.weights - row.weights)};
+    }
+
+    value_type min() const
+    {
+        return 0;
+    }
+
+    // A set without rows has no outputs
+    value_type max() const
+    {
+        assert(m_max_size > 0);
+        return m_max_size - 1;
+    }
+
+    // Identifies the rows without comparing them. Copies share the id until a row is added.
+    std::uint64_t id() const
+    {
+        return m_id;
+    }
+
+  private:
+    struct row_index
+    {
+        value_type weights, outputs;
+    };
+    std::vector<row_index> m_rows;
+    std::vector<value_type> m_weights, m_outputs, m_offsets;
+    size_type m_max_size = 0;
+    std::uint64_t m_id = next_table_id();
+};
+
+// The joint distribution of independent distributions, generated from a single resample.
+// The product of the component sizes must fit in the store.
+template <distribution... Distributions> class product_distribution
+{
+  public:
+    using value_type = std::tuple<typename Distributions::value_type...>;
+    using size_type = std::size_t;
+
+    product_distribution(const Distributions &...dists) : m_components(dists...)
+    {
+    }
+
+    const std::tuple<Distributions...> &components() const
+    {
+        return m_components;
+    }
+
+    value_type min() const
+    {
+        return std::apply([](const auto &...dists) { return value_type{dists.min()...}; }, m_components);
+    }
+
+    value_type max() const
+    {
+        return std::apply([](const auto &...dists) { return value_type{dists.max()...}; }, m_components);
+    }
+
+  private:
+    std::tuple<Distributions...> m_components;
+};
+
+// k independent uniform distributions chosen at runtime, generated into a span.
+// Components are grouped so that each group is generated from a single resample.
+template <std::integral T> class uniform_tuple
+{
+  public:
+    using value_type = std::vector<T>;
+    using size_type = std::size_t;
+
+    uniform_tuple(std::vector<uniform_distribution<T>> components) : m_components(std::move(components))
+    {
+    }
+
+    uniform_tuple(std::initializer_list<uniform_distribution<T>> components)
+        : uniform_tuple(std::vector(components))
+    {
+    }
+
+    std::span<const uniform_distribution<T>> components() const
+    {
+        return m_components;
+    }
+
+    size_type size() const
+    {
+        return m_components.size();
+    }
+
+    value_type min() const
+    {
+        value_type result;
+        for (auto &c : m_components)
+            result.push_back(c.min());
+        return result;
+    }
+
+    value_type max() const
+    {
+        value_type result;
+        for (auto &c : m_components)
+            result.push_back(c.max());
+        return result;
+    }
+
+  private:
+    std::vector<uniform_distribution<T>> m_components;
 };
 
 template <typename Source>
@@ -227,6 +560,13 @@ concept entropy_generator = requires(Source source) {
     source();              // !! Check types
 };
 
+// A source that can also write many values at once, which is usually much faster than
+// calling it once per value
+template <typename Source>
+concept bulk_entropy_generator = entropy_generator<Source> && requires(Source source, std::span<typename Source::value_type> values) {
+    source.fill(values);
+};
+
 template <typename Source>
 concept binary_entropy_generator = entropy_generator<Source> and 
     std::is_same_v<typename Source::distribution_type, binary_distribution>;
@@ -297,7 +637,7 @@ template <entropy_generator Source> class bit_generator
     {
         if (++m_shift >= m_bits)
         {
-            m_value = m_source();
+            m_value = next_word();
             m_shift = 0;
         }
         return (m_value >> m_shift) & 1;
@@ -306,13 +646,292 @@ template <entropy_generator Source> class bit_generator
     constexpr int bits() const { return 1; }
 
   private:
+    static constexpr bool has_fill = bulk_entropy_generator<Source>;
+
+    // Sources that can fill a buffer in bulk are read a block of words at a time
+    value_type next_word()
+    {
+        if constexpr (has_fill)
+        {
+            if (m_next == m_words.size())
+            {
+                m_source.fill(std::span{m_words});
+                m_next = 0;
+            }
+            return m_words[m_next++];
+        }
+        else
+            return m_source();
+    }
+
+    struct no_words
+    {
+    };
+
     constexpr static value_type m_bits = 8 * sizeof(value_type);
     value_type m_value = 0, m_shift = m_bits;
     Source m_source;
+    std::conditional_t<has_fill, std::array<value_type, 16>, no_words> m_words;
+    std::size_t m_next = 16;
 };
 
 using random_bit_generator = bit_generator<random_device_generator>;
 
+// Splits each word of a source into chunks of Bits bits, so that a store fetches many bits at once
+// instead of one at a time as from a bit_generator. Chunks must evenly divide the source's words,
+// and the source must produce every value of its value_type.
+template <entropy_generator Source, int Bits> class chunk_generator
+{
+  public:
+    using source_type = Source;
+    using value_type = typename Source::value_type;
+    using distribution_type = const_uniform_distribution<value_type, 0, (value_type(1) << Bits) - 1>;
+
+    static_assert(Bits > 0 && Bits < 32 && (8 * sizeof(value_type)) % Bits == 0, "Invalid chunk size");
+
+    chunk_generator(const source_type &source) : m_source(source)
+    {
+    }
+    chunk_generator(source_type &&source = {}) : m_source(std::move(source))
+    {
+    }
+
+    const source_type &source() const
+    {
+        return m_source;
+    }
+
+    distribution_type distribution() const
+    {
+        return {};
+    }
+
+    value_type operator()()
+    {
+        if (m_shift == m_bits)
+        {
+            m_value = m_source();
+            m_shift = 0;
+        }
+        value_type chunk = (m_value >> m_shift) & mask;
+        m_shift += Bits;
+        return chunk;
+    }
+
+    constexpr int bits() const
+    {
+        return Bits;
+    }
+
+  private:
+    constexpr static int m_bits = 8 * sizeof(value_type);
+    constexpr static value_type mask = (value_type(1) << Bits) - 1;
+    value_type m_value = 0;
+    int m_shift = m_bits;
+    Source m_source;
+};
+
+// Thrown by a reserved_source with max_fetches of 0 when its reserve stays empty for longer than its
+// wait limit, because nothing is replenishing it
+class reserve_starved : public std::runtime_error
+{
+  public:
+    reserve_starved(std::chrono::nanoseconds waited)
+        : std::runtime_error("Reserve empty for " + std::to_string(waited.count()) + " ns")
+    {
+    }
+};
+
+// Serves values fetched from a source ahead of time, so that the latency of a store is usually
+// bounded. The store takes values from the reserve while it generates, and before each output tops
+// the reserve up with at most max_fetches values. An output that empties the reserve overruns it,
+// and then fetches from the source directly for as many values as it still needs, without bound.
+//
+// max_fetches must exceed the average number of values an output consumes, so that the reserve stays
+// full. Failed samples then have to exhaust the whole reserve within a few outputs to overrun it, so
+// overruns are rare in a large enough reserve, and overruns() counts them.
+//
+// With max_fetches of 0, outputs never call the source, and the reserve is only filled by
+// replenish(), for example from a helper thread while another thread generates. An output then waits
+// for the reserve when it is empty, and throws reserve_starved if nothing refills it within the
+// wait limit. The store is then part way through an output, and must be discarded.
+//
+// The reserve is a single-producer, single-consumer ring. Only a source with max_fetches of 0 may be
+// replenished, because otherwise the store also writes to the ring before each output. One thread
+// may then call replenish() while the store generates on another, but nothing else is thread-safe.
+template <entropy_generator Source> class reserved_source
+{
+  public:
+    using source_type = Source;
+    using value_type = typename Source::value_type;
+    using distribution_type = typename Source::distribution_type;
+
+    // The capacity is rounded up to a power of 2
+    reserved_source(const source_type &source, std::size_t capacity = 256, std::size_t max_fetches = 4,
+                    std::chrono::nanoseconds wait_limit = std::chrono::seconds(1))
+        : m_source(source), m_reserve(std::bit_ceil(std::max<std::size_t>(capacity, 1))),
+          m_max_fetches(max_fetches), m_wait_limit(wait_limit)
+    {
+        fill(this->capacity());
+    }
+
+    // A copy does not share the values already reserved, and fetches its own
+    reserved_source(const reserved_source &other)
+        : reserved_source(other.m_source, other.capacity(), other.m_max_fetches, other.m_wait_limit)
+    {
+    }
+
+    reserved_source(reserved_source &&other)
+        : m_source(std::move(other.m_source)), m_reserve(std::move(other.m_reserve)),
+          m_read(other.m_read.load()), m_write(other.m_write.load()), m_max_fetches(other.m_max_fetches),
+          m_wait_limit(other.m_wait_limit), m_overruns(other.m_overruns)
+    {
+    }
+
+    const source_type &source() const
+    {
+        return m_source;
+    }
+
+    distribution_type distribution() const
+    {
+        return m_source.distribution();
+    }
+
+    constexpr int bits() const
+    {
+        return m_source.bits();
+    }
+
+    value_type operator()()
+    {
+        auto read = m_read.load(std::memory_order_relaxed);
+        if (read == m_write.load(std::memory_order_acquire)) [[unlikely]]
+        {
+            m_overruns += !m_overran;
+            m_overran = true;
+            if (m_max_fetches > 0)
+                return m_source();
+            auto deadline = std::chrono::steady_clock::now() + m_wait_limit;
+            while (read == m_write.load(std::memory_order_acquire))
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                    throw reserve_starved(m_wait_limit);
+                std::this_thread::yield();
+            }
+        }
+        auto value = m_reserve[read & (m_reserve.size() - 1)];
+        m_read.store(read + 1, std::memory_order_release);
+        return value;
+    }
+
+    // Fetches up to `count` values from the source into the reserve, and returns how many it fetched.
+    // Only valid with max_fetches of 0, as the store is otherwise the producer.
+    std::size_t replenish(std::size_t count)
+    {
+        assert(m_max_fetches == 0);
+        return fill(count);
+    }
+
+    // Fetches at most max_fetches values, which the store does before each output
+    void top_up()
+    {
+        m_overran = false;
+        fill(m_max_fetches);
+    }
+
+    // Grows the reserve to hold at least `values`, and fills it. This must not run at the same
+    // time as replenish() or the store.
+    void reserve(std::size_t values)
+    {
+        if (values > capacity())
+        {
+            auto read = m_read.load(), write = m_write.load();
+            std::vector<value_type> reserve(std::bit_ceil(values));
+            for (auto i = read; i != write; ++i)
+                reserve[i - read] = m_reserve[i & (m_reserve.size() - 1)];
+            m_reserve = std::move(reserve);
+            m_read = 0;
+            m_write = write - read;
+        }
+        fill(capacity());
+    }
+
+    std::size_t reserved() const
+    {
+        return m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const
+    {
+        return m_reserve.size();
+    }
+
+    std::size_t max_fetches() const
+    {
+        return m_max_fetches;
+    }
+
+    // Outputs that found the reserve empty, and fetched from the source or waited
+    std::size_t overruns() const
+    {
+        return m_overruns;
+    }
+
+    std::chrono::nanoseconds wait_limit() const
+    {
+        return m_wait_limit;
+    }
+
+  private:
+    std::size_t fill(std::size_t count)
+    {
+        auto write = m_write.load(std::memory_order_relaxed);
+        count = std::min(count, m_reserve.size() - (write - m_read.load(std::memory_order_acquire)));
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            m_reserve[(write + i) & (m_reserve.size() - 1)] = m_source();
+            m_write.store(write + i + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    Source m_source;
+    std::vector<value_type> m_reserve;
+    // Values ever read and written, which index the reserve modulo its size
+    std::atomic<std::size_t> m_read = 0, m_write = 0;
+    std::size_t m_max_fetches;
+    std::chrono::nanoseconds m_wait_limit;
+    std::size_t m_overruns = 0;
+    // Whether the current output has overrun, so that it is counted once
+    bool m_overran = false;
+};
+
+// Called by a store before each output, so that a source can do its work between outputs. Only
+// reserved_source does anything.
+template <entropy_generator Source> void before_output(Source &)
+{
+}
+
+template <entropy_generator Source> void before_output(reserved_source<Source> &source)
+{
+    source.top_up();
+}
+
+// Called by entropy_store::reserve() to buffer at least `bits` more bits of entropy in the source,
+// and returns the bits the source has buffered. Only reserved_source buffers anything.
+template <entropy_generator Source> double reserve_entropy(Source &, double)
+{
+    return 0;
+}
+
+template <entropy_generator Source> double reserve_entropy(reserved_source<Source> &source, double bits)
+{
+    double bits_per_value = std::log2(double(source.distribution().size()));
+    source.reserve(std::size_t(std::ceil(std::max(bits, 0.0) / bits_per_value)));
+    return source.reserved() * bits_per_value;
+}
+
 void validate(std::integral auto U_n, std::integral auto n)
 {
     assert(U_n < n);
@@ -356,22 +975,74 @@ template <std::integral uint_t> auto resample(uint_t U_n, uint_t n, uint_t m)
     return std::tuple{U_x, x, B};
 }
 
+// Called when rejection sampling reduces the store from size `before` to size `after`, where
+// `accepted` says whether the sample was kept. Only instrumented fetches record anything.
+template <typename Fn, std::integral uint_t> void note_rejection_sample(const Fn &, uint_t, uint_t, uint_t)
+{
+}
+
+// Refill policies choose the size T below which the store refills, up to the same limit N, before
+// generating an output of n outcomes. Refilling less often keeps fewer bits in the store, so each
+// sample fails with probability below (n - 1) / T, and always below 1/2. A sample from a store of
+// size s that fails with probability p loses h(p) bits, where h is the binary entropy function, so
+// an output loses fewer than h(q) / (1 - q) bits in expectation, where q = min((n - 1) / T, 1/2).
+
+// Refills below N, so the store loses the least entropy. This is the default.
+struct max_efficiency
+{
+    template <std::integral uint_t> static constexpr uint_t threshold(uint_t N, uint_t)
+    {
+        return N;
+    }
+};
+
+// Refills only when the store has fewer than 2^Bits outputs left, or below N if that is lower, so
+// outputs lose fewer than h(2^-Bits) / (1 - 2^-Bits) bits each: under 0.037 bits for 8, and under
+// 2.6e-4 bits for 16.
+template <int Bits> struct target_loss
+{
+    static_assert(Bits >= 0 && Bits < 64);
+
+    template <std::integral uint_t> static constexpr uint_t threshold(uint_t N, uint_t n)
+    {
+        if constexpr (Bits >= std::numeric_limits<uint_t>::digits)
+            return N;
+        else
+            return n <= (N >> Bits) ? uint_t(n << Bits) : N;
+    }
+};
+
+// Refills only when the store cannot generate the output at all, so that refills are rare and long.
+// Outputs lose fewer than 2 bits each.
+using max_throughput = target_loss<0>;
+
+// The size below which the store refills. Only fetches wrapped with a refill policy change it.
+template <typename Fn, std::integral uint_t> uint_t refill_threshold(const Fn &, uint_t N, uint_t)
+{
+    return N;
+}
+
 template <std::integral uint_t, std::invocable<uint_t, uint_t> Fn>
 auto generate_multiple(uint_t U_s, uint_t s, uint_t N, uint_t n, Fn fetch_entropy)
 {
     assert(N >= n);
     validate(U_s, s);
+    const uint_t T = refill_threshold(fetch_entropy, N, n);
+    assert(T >= n && T <= N);
     for (;;)
     {
-        while (s < N)
-            std::tie(U_s, s) = fetch_entropy(U_s, s);
+        if (s < T)
+            while (s < N)
+                std::tie(U_s, s) = fetch_entropy(U_s, s);
         assert(s >= n);
         validate(U_s, s);
         // Resample entropy s to a multiple of m
         uint_t k = s / n;
         uint_t r = s % n;
         uint_t B;
-        std::tie(U_s, s, B) = resample(U_s, s, s - r);
+        std::tie(U_s, s, B) = resample(U_s, s, uint_t(s - r));
+        if (r)
+            note_rejection_sample(fetch_entropy, uint_t(B ? s + r : s + k * n), s, B);
         // s -= r;
         if (B) [[likely]]
         {
@@ -387,17 +1058,22 @@ template <std::uint32_t n, std::integral uint_t, std::invocable<uint_t, uint_t>
 auto generate_const_multiple(uint_t U_s, uint_t s, uint_t N, Fn fetch_entropy)
 {
     assert(N >= n);
+    const uint_t T = refill_threshold(fetch_entropy, N, uint_t(n));
+    assert(T >= n && T <= N);
     for (;;)
     {
-        while (s < N)
-            std::tie(U_s, s) = fetch_entropy(U_s, s);
+        if (s < T)
+            while (s < N)
+                std::tie(U_s, s) = fetch_entropy(U_s, s);
         assert(s >= n);
         validate(U_s, s);
         // Resample entropy s to a multiple of m
         uint_t k = s / n;
         uint_t r = s % n;
         uint_t B;
-        std::tie(U_s, s, B) = resample(U_s, s, s - r);
+        std::tie(U_s, s, B) = resample(U_s, s, uint_t(s - r));
+        if (r)
+            note_rejection_sample(fetch_entropy, uint_t(B ? s + r : s + k * n), s, B);
         // s -= r;
         if (B) [[likely]]
         {
@@ -498,7 +1174,7 @@ uint_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t>
 
 template <std::integral uint_t>
 uint_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
-                const weighted_distribution &output_dist)
+                const weighted_table auto &output_dist)
 {
     uint_t k;
 
@@ -509,6 +1185,13 @@ uint_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t>
     return W;
 }
 
+template <std::integral uint_t>
+uint_t generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                const weighted_table_set &output_dist, std::size_t row)
+{
+    return generate(U_s, s, N, fetch_entropy, output_dist[row]);
+}
+
 template <std::integral uint_t, typename U2, U2 Min, U2 Max>
 U2 generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
                 const const_uniform_distribution<U2, Min, Max> &output_dist)
@@ -518,7 +1201,303 @@ U2 generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> aut
     return U_n + output_dist.min();
 }
 
-template <entropy_generator Source, std::integral Buffer = std::uint32_t> class entropy_store
+// The number of equally likely outcomes that a distribution is generated from
+template <std::integral T> std::size_t outcomes(const uniform_distribution<T> &dist)
+{
+    return dist.size();
+}
+
+template <std::integral T, T Min, T Max> constexpr std::size_t outcomes(const const_uniform_distribution<T, Min, Max> &)
+{
+    return Max - Min + 1;
+}
+
+inline std::size_t outcomes(const bernoulli_distribution &dist)
+{
+    return dist.denominator();
+}
+
+template <std::integral uint_t, uint_t M, uint_t N>
+constexpr std::size_t outcomes(const const_bernoulli_distribution<uint_t, M, N> &)
+{
+    return N;
+}
+
+std::size_t outcomes(const weighted_table auto &dist)
+{
+    return dist.outputs().size();
+}
+
+template <distribution... Distributions> std::size_t outcomes(const product_distribution<Distributions...> &dist)
+{
+    return std::apply([](const auto &...dists) { return (outcomes(dists) * ...); }, dist.components());
+}
+
+// The number of outcomes if known at compile time, otherwise 0
+template <typename Distribution> constexpr std::size_t const_outcomes = 0;
+
+template <std::integral T, T Min, T Max>
+constexpr std::size_t const_outcomes<const_uniform_distribution<T, Min, Max>> = Max - Min + 1;
+
+template <std::integral uint_t, uint_t M, uint_t N>
+constexpr std::size_t const_outcomes<const_bernoulli_distribution<uint_t, M, N>> = N;
+
+// Maps an outcome U_n < outcomes(dist) to a value, and returns the entropy (U_x, x)
+// left over in U_n so that it can be returned to the store.
+template <std::integral uint_t, std::integral T> auto decode(uint_t U_n, const uniform_distribution<T> &dist)
+{
+    return std::tuple{T(U_n + dist.min()), uint_t(0), uint_t(1)};
+}
+
+template <std::integral uint_t, std::integral T, T Min, T Max>
+auto decode(uint_t U_n, const const_uniform_distribution<T, Min, Max> &)
+{
+    return std::tuple{T(U_n + Min), uint_t(0), uint_t(1)};
+}
+
+template <std::integral uint_t> auto decode(uint_t U_n, const bernoulli_distribution &dist)
+{
+    auto [U_x, x, B] = resample(U_n, uint_t(dist.denominator()), uint_t(dist.numerator()));
+    return std::tuple{bernoulli_distribution::value_type(B), U_x, x};
+}
+
+template <std::integral uint_t, std::integral U, U M, U N>
+auto decode(uint_t U_n, const const_bernoulli_distribution<U, M, N> &)
+{
+    auto [U_x, x, B] = resample(U_n, uint_t(N), uint_t(M));
+    return std::tuple{typename const_bernoulli_distribution<U, M, N>::value_type(B), U_x, x};
+}
+
+template <std::integral uint_t> auto decode(uint_t U_n, const weighted_table auto &dist)
+{
+    auto W = dist.outputs()[U_n];
+    return std::tuple{W, uint_t(U_n - dist.offsets()[W]), uint_t(dist.weights()[W])};
+}
+
+template <std::integral uint_t, distribution... Distributions>
+auto generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+              const product_distribution<Distributions...> &output_dist)
+{
+    using value_type = typename product_distribution<Distributions...>::value_type;
+    constexpr auto n = (const_outcomes<Distributions> * ...);
+
+    uint_t k;
+    if constexpr (n > 0)
+        std::tie(U_s, s, k) = generate_const_multiple<n>(U_s, s, N, fetch_entropy);
+    else
+        std::tie(U_s, s, k) = generate_multiple(U_s, s, N, uint_t(outcomes(output_dist)), fetch_entropy);
+
+    // Peel off each component, and keep the unused entropy in (U_r, r)
+    uint_t U_r = 0, r = 1;
+    auto component = [&](const auto &dist) {
+        uint_t U_n;
+        std::tie(U_s, s, U_n) = divide(U_s, s, uint_t(outcomes(dist)));
+        auto [value, U_x, x] = decode(U_n, dist);
+        std::tie(U_r, r) = combine(U_r, r, U_x, x);
+        return value;
+    };
+    auto result = std::apply([&](const auto &...dists) { return value_type{component(dists)...}; },
+                             output_dist.components());
+    std::tie(U_s, s) = combine(U_r, r, U_s, s);
+    return result;
+}
+
+template <std::integral uint_t, std::integral T>
+void generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+              const uniform_tuple<T> &output_dist, std::span<T> output)
+{
+    assert(output.size() == output_dist.size());
+    // Limit the size of each group to keep the rejection rate low
+    const uint_t max_group = N >> 8;
+    auto components = output_dist.components();
+    for (std::size_t i = 0; i < components.size();)
+    {
+        auto end = i + 1;
+        uint_t n = components[i].size();
+        while (end < components.size() && n <= max_group / components[end].size())
+            n *= components[end++].size();
+
+        uint_t k, U_n;
+        std::tie(U_s, s, k) = generate_multiple(U_s, s, N, n, fetch_entropy);
+        for (; i < end; ++i)
+        {
+            std::tie(U_s, s, U_n) = divide(U_s, s, uint_t(components[i].size()));
+            output[i] = U_n + components[i].min();
+        }
+    }
+}
+
+template <std::integral uint_t, std::integral T>
+std::vector<T> generate(uint_t &U_s, uint_t &s, uint_t N, std::invocable<uint_t, uint_t> auto fetch_entropy,
+                        const uniform_tuple<T> &output_dist)
+{
+    std::vector<T> result(output_dist.size());
+    generate(U_s, s, N, fetch_entropy, output_dist, std::span{result});
+    return result;
+}
+
+// The default instrumentation policy of an entropy_store, which records nothing and costs nothing
+struct no_instrumentation
+{
+};
+
+// What a store spent generating a distribution
+struct entropy_stats
+{
+    std::uint64_t outputs = 0;    // Calls to the store
+    std::uint64_t refills = 0;    // Runs of fetches to bring the store back up to size
+    std::uint64_t fetches = 0;    // Values fetched from the source
+    std::uint64_t rejections = 0; // Rejection samples that failed and had to be retried
+    // Entropy lost to the store's rejection samples, whether or not the sample was kept. Distributions
+    // that reject whole draws, such as zipf_distribution and the Gaussians, lose more than this.
+    double discarded_bits = 0;
+
+    entropy_stats &operator+=(const entropy_stats &other)
+    {
+        outputs += other.outputs;
+        refills += other.refills;
+        fetches += other.fetches;
+        rejections += other.rejections;
+        discarded_bits += other.discarded_bits;
+        return *this;
+    }
+};
+
+template <typename Fetch> struct instrumented_fetch;
+
+// An instrumentation policy that keeps entropy_stats for each distribution type
+class counting_instrumentation
+{
+  public:
+    struct entry
+    {
+        std::type_index distribution;
+        entropy_stats stats;
+    };
+
+    counting_instrumentation() = default;
+
+    // A copied store has generated nothing yet
+    counting_instrumentation(const counting_instrumentation &)
+    {
+    }
+
+    counting_instrumentation(counting_instrumentation &&) = default;
+
+    // Counts one output of the distribution, and wraps the store's fetch function to count its fetches
+    template <typename Distribution, typename Fetch>
+    instrumented_fetch<Fetch> instrument(Fetch fetch, std::uint64_t /*source_size*/, const Distribution &,
+                                         const auto &...)
+    {
+        auto &stats = record<Distribution>();
+        ++stats.outputs;
+        m_refilling = false;
+        return {fetch, &stats, &m_refilling};
+    }
+
+    // The stats for one distribution type
+    template <typename Distribution> entropy_stats stats() const
+    {
+        for (auto &e : m_entries)
+            if (e.distribution == typeid(Distribution))
+                return e.stats;
+        return {};
+    }
+
+    // The stats for all distributions together
+    entropy_stats total() const
+    {
+        entropy_stats result;
+        for (auto &e : m_entries)
+            result += e.stats;
+        return result;
+    }
+
+    // The stats for each distribution type that has been generated
+    std::vector<entry> snapshot() const
+    {
+        return m_entries;
+    }
+
+    void reset()
+    {
+        m_entries.clear();
+    }
+
+  private:
+    template <typename Distribution> entropy_stats &record()
+    {
+        for (auto &e : m_entries)
+            if (e.distribution == typeid(Distribution))
+                return e.stats;
+        return m_entries.emplace_back(typeid(Distribution)).stats;
+    }
+
+    std::vector<entry> m_entries;
+    // Set between consecutive fetches, so that a run of them counts as one refill
+    bool m_refilling = false;
+};
+
+// Wraps a store's fetch function to count into a counting_instrumentation
+template <typename Fetch> struct instrumented_fetch
+{
+    Fetch fetch;
+    entropy_stats *stats;
+    bool *refilling;
+
+    template <std::integral uint_t> auto operator()(uint_t U_s, uint_t s) const
+    {
+        if (!*refilling)
+        {
+            ++stats->refills;
+            *refilling = true;
+        }
+        ++stats->fetches;
+        return fetch(U_s, s);
+    }
+};
+
+template <typename Fetch, std::integral uint_t>
+void note_rejection_sample(const instrumented_fetch<Fetch> &fetch, uint_t before, uint_t after, uint_t accepted)
+{
+    *fetch.refilling = false;
+    if (!accepted)
+        ++fetch.stats->rejections;
+    fetch.stats->discarded_bits += std::log2(double(before) / double(after));
+}
+
+// Wraps a store's fetch function, outside any instrumentation, to refill by a RefillPolicy
+template <typename Fetch, typename RefillPolicy> struct threshold_fetch
+{
+    Fetch fetch;
+
+    template <std::integral uint_t> auto operator()(uint_t U_s, uint_t s) const
+    {
+        return fetch(U_s, s);
+    }
+};
+
+template <typename Fetch, typename RefillPolicy, std::integral uint_t>
+uint_t refill_threshold(const threshold_fetch<Fetch, RefillPolicy> &, uint_t N, uint_t n)
+{
+    return RefillPolicy::threshold(N, n);
+}
+
+template <typename Fetch, typename RefillPolicy, std::integral uint_t>
+void note_rejection_sample(const threshold_fetch<Fetch, RefillPolicy> &fetch, uint_t before, uint_t after,
+                           uint_t accepted)
+{
+    note_rejection_sample(fetch.fetch, before, after, accepted);
+}
+
+// Extracts entropy from a source into a buffer (U_s, s) and generates distributions from it.
+// The Instrumentation policy can be counting_instrumentation to record entropy_stats, or
+// telemetry_instrumentation to publish counters from a service. Instrumentation is compiled out
+// entirely with the default no_instrumentation. The RefillPolicy trades efficiency for fewer
+// refills: max_efficiency, target_loss<Bits> or max_throughput.
+template <entropy_generator Source, std::integral Buffer = std::uint32_t,
+          typename Instrumentation = no_instrumentation, typename RefillPolicy = max_efficiency>
+class entropy_store
 {
   public:
     using value_type = Buffer;
@@ -528,19 +1507,59 @@ template <entropy_generator Source, std::integral Buffer = std::uint32_t> class
     {
     }
 
-    entropy_store(entropy_store &&other) : m_source(std::move(other.m_source)), U_s(other.U_s), s(other.s)
+    entropy_store(const Source &src, Instrumentation instrumentation)
+        : m_source(src), m_instrumentation(std::move(instrumentation))
+    {
+    }
+
+    entropy_store(entropy_store &&other)
+        : m_source(std::move(other.m_source)), m_instrumentation(std::move(other.m_instrumentation)), U_s(other.U_s),
+          s(other.s)
     {
         other.U_s = 0;
         other.s = 1;
     }
 
-    entropy_store(const entropy_store &other) : m_source(other.m_source)
+    entropy_store(const entropy_store &other) : m_source(other.m_source), m_instrumentation(other.m_instrumentation)
     {
     }
 
-    auto operator()(const distribution auto &dist)
+    auto operator()(const distribution auto &dist, const auto &...args)
     {
-        return generate(U_s, s, N, fetch_from_source<value_type>(m_source, m_source.distribution()), dist);
+        before_output(m_source);
+        auto fetch = fetch_from_source<value_type>(m_source, m_source.distribution());
+        if constexpr (std::is_same_v<Instrumentation, no_instrumentation>)
+            return generate(U_s, s, N, refill_by<RefillPolicy>(fetch), dist, args...);
+        else
+            return generate(U_s, s, N,
+                            refill_by<RefillPolicy>(
+                                m_instrumentation.instrument(fetch, std::uint64_t(m_source.distribution().size()),
+                                                             dist, args...)),
+                            dist, args...);
+    }
+
+    // Fetches entropy until the store is full, and fills the reserve of a reserved_source, so that
+    // the next outputs do not wait for the source. The store starts empty, so call this in idle time.
+    void prefill()
+    {
+        reserve(0);
+    }
+
+    // Fills the store, then buffers the rest of `bits` in the reserve of a reserved_source, growing it
+    // if needed. Returns the bits buffered, which is at most the size of the store for other sources.
+    double reserve(double bits)
+    {
+        // A reserve that only a helper thread fills must hold enough to fill the store
+        reserve_entropy(m_source, bits + 8 * sizeof(value_type));
+        auto fetch = fetch_from_source<value_type>(m_source, m_source.distribution());
+        while (s < N)
+            std::tie(U_s, s) = fetch(U_s, s);
+        return std::log2(double(s)) + reserve_entropy(m_source, bits - std::log2(double(s)));
+    }
+
+    const Instrumentation &instrumentation() const
+    {
+        return m_instrumentation;
     }
 
     value_type size() const
@@ -553,8 +1572,24 @@ template <entropy_generator Source, std::integral Buffer = std::uint32_t> class
         return m_source;
     }
 
+    // For example to replenish a reserved_source from another thread
+    source_type &source()
+    {
+        return m_source;
+    }
+
   private:
+    // The default policy leaves the fetch function as it is
+    template <typename Policy, typename Fetch> static auto refill_by(Fetch fetch)
+    {
+        if constexpr (std::is_same_v<Policy, max_efficiency>)
+            return fetch;
+        else
+            return threshold_fetch<Fetch, Policy>{fetch};
+    }
+
     source_type m_source;
+    [[no_unique_address]] Instrumentation m_instrumentation;
     value_type N = value_type(1) << (sizeof(value_type) * 8 - m_source.distribution().bits());
     value_type U_s = 0, s = 1;
 };
@@ -596,16 +1631,18 @@ template <entropy_generator Source> using entropy_store32 = entropy_store<Source
 
 template <entropy_generator Source> using entropy_store64 = entropy_store<Source, std::uint64_t>;
 
-template <entropy_generator Source, std::integral Buffer, std::random_access_iterator It>
-void shuffle(entropy_store<Source, Buffer> &store, It a, It b)
+template <entropy_generator Source, std::integral Buffer, typename Instrumentation, typename RefillPolicy,
+          std::random_access_iterator It>
+void shuffle(entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &store, It a, It b)
 {
     auto size = std::distance(a, b);
     for (int i = 1; i < size; ++i)
         std::swap(a[i], a[store(uniform_distribution{0, i})]);
 }
 
-template <entropy_generator Source, std::integral Buffer>
-void shuffle(entropy_store<Source, Buffer> &store, std::ranges::random_access_range auto &cards)
+template <entropy_generator Source, std::integral Buffer, typename Instrumentation, typename RefillPolicy>
+void shuffle(entropy_store<Source, Buffer, Instrumentation, RefillPolicy> &store,
+             std::ranges::random_access_range auto &cards)
 {
     return shuffle(store, cards.begin(), cards.end());
 }
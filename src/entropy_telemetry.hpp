@@ -0,0 +1,393 @@
+#pragma once
+
+#include "entropy_metrics.hpp"
+#include "entropy_store.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+
+namespace entropy_store
+{
+// Efficiency counters for a long-running service, shared by any number of stores (a pool) on any
+// threads. Give each store a telemetry_instrumentation, and call snapshot() or publish() from
+// anywhere to aggregate them.
+//
+// Each store owns its counters and is the only thread to write them, so generation uses relaxed
+// atomic loads and stores without locks or read-modify-write instructions. The mutex is only taken
+// when a store attaches and when counters are read.
+//
+// Output entropy is the entropy of each distribution, computed once and cached by the store, times
+// the number of values generated. Input minus discarded bits would overestimate it, because
+// distributions such as zipf_distribution and the Gaussians reject whole draws without passing
+// through a counted rejection sample. Discarded bits only count the failed rejection samples of
+// the store itself.
+class entropy_telemetry
+{
+  public:
+    // The counters of one store
+    struct counters
+    {
+        std::atomic<std::uint64_t> outputs = 0, fetches = 0, rejections = 0;
+        std::atomic<double> discarded_bits = 0, output_bits = 0;
+        // The number of values the source can fetch, so each fetch is log2(source_size) bits
+        std::atomic<std::uint64_t> source_size = 0;
+    };
+
+    struct snapshot_type
+    {
+        std::uint64_t stores = 0, outputs = 0, fetches = 0, rejections = 0;
+        double input_bits = 0, discarded_bits = 0, output_bits = 0;
+        // Seconds since the telemetry was created
+        double seconds = 0;
+
+        double efficiency() const
+        {
+            return input_bits > 0 ? output_bits / input_bits : 1;
+        }
+
+        double input_bits_per_second() const
+        {
+            return seconds > 0 ? input_bits / seconds : 0;
+        }
+
+        double output_bits_per_second() const
+        {
+            return seconds > 0 ? output_bits / seconds : 0;
+        }
+
+        // The counts over the interval between two snapshots
+        snapshot_type operator-(const snapshot_type &earlier) const
+        {
+            return {stores,
+                    outputs - earlier.outputs,
+                    fetches - earlier.fetches,
+                    rejections - earlier.rejections,
+                    input_bits - earlier.input_bits,
+                    discarded_bits - earlier.discarded_bits,
+                    output_bits - earlier.output_bits,
+                    seconds - earlier.seconds};
+        }
+    };
+
+    using callback_type = std::function<void(const snapshot_type &)>;
+
+    entropy_telemetry() : m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    entropy_telemetry(const entropy_telemetry &) = delete;
+    entropy_telemetry &operator=(const entropy_telemetry &) = delete;
+
+    // New counters for a store. The telemetry keeps them after the store is destroyed.
+    std::shared_ptr<counters> attach()
+    {
+        auto result = std::make_shared<counters>();
+        std::lock_guard lock(m_mutex);
+        m_counters.push_back(result);
+        return result;
+    }
+
+    // Sums the counters of all stores. Each counter is read atomically, but stores may generate
+    // while they are read, so the totals need not be from a single instant.
+    snapshot_type snapshot() const
+    {
+        std::lock_guard lock(m_mutex);
+        snapshot_type result = m_retired;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        for (auto &c : m_counters)
+        {
+            // Stores that still exist hold another reference
+            result.stores += c.use_count() > 1;
+            add(result, *c);
+        }
+        return result;
+    }
+
+    // Calls the callback from publish()
+    void on_publish(callback_type callback)
+    {
+        std::lock_guard lock(m_mutex);
+        m_callback = std::move(callback);
+    }
+
+    // Takes a snapshot and passes it to the callback, for example from a timer thread. The counters
+    // of destroyed stores are folded into a single total here.
+    snapshot_type publish()
+    {
+        callback_type callback;
+        {
+            std::lock_guard lock(m_mutex);
+            std::erase_if(m_counters, [&](auto &c) {
+                if (c.use_count() > 1)
+                    return false;
+                add(m_retired, *c);
+                return true;
+            });
+            callback = m_callback;
+        }
+        auto result = snapshot();
+        if (callback)
+            callback(result);
+        return result;
+    }
+
+  private:
+    static void add(snapshot_type &result, const counters &c)
+    {
+        auto fetches = c.fetches.load(std::memory_order_relaxed);
+        auto source_size = c.source_size.load(std::memory_order_relaxed);
+        result.outputs += c.outputs.load(std::memory_order_relaxed);
+        result.fetches += fetches;
+        result.rejections += c.rejections.load(std::memory_order_relaxed);
+        result.input_bits += fetches ? fetches * std::log2(double(source_size)) : 0;
+        result.discarded_bits += c.discarded_bits.load(std::memory_order_relaxed);
+        result.output_bits += c.output_bits.load(std::memory_order_relaxed);
+    }
+
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<counters>> m_counters;
+    snapshot_type m_retired;
+    callback_type m_callback;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Writes a snapshot in the Prometheus text exposition format, with metric names starting with prefix
+inline void write_prometheus(std::ostream &os, const entropy_telemetry::snapshot_type &snapshot,
+                             std::string_view prefix = "entropy_store")
+{
+    auto metric = [&](std::string_view name, std::string_view type, std::string_view help, auto value) {
+        os << "# HELP " << prefix << '_' << name << ' ' << help << '\n';
+        os << "# TYPE " << prefix << '_' << name << ' ' << type << '\n';
+        os << prefix << '_' << name << ' ' << value << '\n';
+    };
+    metric("stores", "gauge", "Stores currently attached.", snapshot.stores);
+    metric("outputs_total", "counter", "Values generated.", snapshot.outputs);
+    metric("fetches_total", "counter", "Values fetched from entropy sources.", snapshot.fetches);
+    metric("rejections_total", "counter", "Rejection samples that were retried.", snapshot.rejections);
+    metric("input_bits_total", "counter", "Entropy fetched from sources, in bits.", snapshot.input_bits);
+    metric("discarded_bits_total", "counter", "Entropy lost to failed rejection samples, in bits.", snapshot.discarded_bits);
+    metric("output_bits_total", "counter", "Entropy of the generated values, in bits.", snapshot.output_bits);
+    metric("efficiency", "gauge", "Output entropy as a fraction of input entropy.", snapshot.efficiency());
+    metric("output_bits_per_second", "gauge", "Output entropy per second since the telemetry was created.",
+           snapshot.output_bits_per_second());
+}
+
+template <typename Fetch> struct telemetry_fetch;
+
+template <typename Distribution> constexpr bool is_uniform_tuple = false;
+template <std::integral T> constexpr bool is_uniform_tuple<uniform_tuple<T>> = true;
+
+// Mixes a value into a hash, with the finalizer of splitmix64
+inline std::uint64_t hash_combine(std::uint64_t hash, std::uint64_t value)
+{
+    std::uint64_t z = hash ^ (value + 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// A hash of the parameters of a distribution, so that telemetry can cache its entropy. Tables of
+// weights are identified by their id, which copies share, so that they are not hashed for every
+// output. Only tables without an id, such as a weighted_row, are hashed in full.
+template <typename Distribution> std::uint64_t fingerprint(const Distribution &dist)
+{
+    if constexpr (requires { dist.id(); })
+        return dist.id();
+    else if constexpr (weighted_table<Distribution>)
+    {
+        std::uint64_t hash = 0;
+        for (auto w : dist.weights())
+            hash = hash_combine(hash, w);
+        return hash;
+    }
+    else if constexpr (std::is_trivially_copyable_v<Distribution>)
+    {
+        std::uint64_t hash = 0;
+        unsigned char bytes[sizeof(Distribution)];
+        std::memcpy(bytes, &dist, sizeof(Distribution));
+        for (std::size_t i = 0; i < sizeof(Distribution); i += 8)
+        {
+            std::uint64_t word = 0;
+            std::memcpy(&word, bytes + i, std::min<std::size_t>(8, sizeof(Distribution) - i));
+            hash = hash_combine(hash, word);
+        }
+        return hash;
+    }
+    else
+        return parameter_fingerprint(dist);
+}
+
+inline std::uint64_t parameter_fingerprint(const geometric_distribution &dist)
+{
+    return hash_combine(dist.numerator(), dist.denominator());
+}
+
+inline std::uint64_t parameter_fingerprint(const negative_binomial_distribution &dist)
+{
+    return hash_combine(dist.successes(), fingerprint(dist.trial()));
+}
+
+inline std::uint64_t parameter_fingerprint(const dice_sum_distribution &dist)
+{
+    return hash_combine(hash_combine(dist.count(), dist.sides()), std::uint64_t(dist.offset()));
+}
+
+inline std::uint64_t parameter_fingerprint(const cdt_gaussian_distribution &dist)
+{
+    return hash_combine(dist.sigma(), std::uint64_t(dist.center()));
+}
+
+template <std::integral T> std::uint64_t parameter_fingerprint(const uniform_tuple<T> &dist)
+{
+    std::uint64_t hash = 0;
+    for (auto &c : dist.components())
+        hash = hash_combine(hash, fingerprint(c));
+    return hash;
+}
+
+template <distribution... Distributions>
+std::uint64_t parameter_fingerprint(const product_distribution<Distributions...> &dist)
+{
+    return std::apply(
+        [](const auto &...dists) {
+            std::uint64_t hash = 0;
+            ((hash = hash_combine(hash, fingerprint(dists))), ...);
+            return hash;
+        },
+        dist.components());
+}
+
+// An instrumentation policy for entropy_store that counts into an entropy_telemetry, which must
+// outlive the store. A copied store gets its own counters in the same telemetry.
+class telemetry_instrumentation
+{
+  public:
+    explicit telemetry_instrumentation(entropy_telemetry &telemetry)
+        : m_telemetry(&telemetry), m_counters(telemetry.attach())
+    {
+    }
+
+    // Moving a store copies too, so that the moved-from store still has counters
+    telemetry_instrumentation(const telemetry_instrumentation &other) : telemetry_instrumentation(*other.m_telemetry)
+    {
+    }
+
+    // Counters have a single writer, so an assigned instrumentation keeps its own, attaching new
+    // ones if it moves to another telemetry
+    telemetry_instrumentation &operator=(const telemetry_instrumentation &other)
+    {
+        if (m_telemetry != other.m_telemetry)
+        {
+            m_telemetry = other.m_telemetry;
+            m_counters = m_telemetry->attach();
+        }
+        return *this;
+    }
+
+    template <typename Distribution, typename Fetch, typename... Args>
+    telemetry_fetch<Fetch> instrument(Fetch fetch, std::uint64_t source_size, const Distribution &dist,
+                                      const Args &...args)
+    {
+        increment(m_counters->outputs);
+        increment(m_counters->output_bits, output_bits(dist, args...));
+        if (m_counters->source_size.load(std::memory_order_relaxed) != source_size)
+            m_counters->source_size.store(source_size, std::memory_order_relaxed);
+        return {fetch, m_counters.get()};
+    }
+
+    const entropy_telemetry::counters &counters() const
+    {
+        return *m_counters;
+    }
+
+    // Only the thread using the store writes its counters, so this needs no read-modify-write
+    template <typename T> static void increment(std::atomic<T> &counter, T amount = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+  private:
+    // A distribution whose entropy is cached, identified by its type, the fingerprint of its
+    // parameters, and the row of a weighted_table_set
+    struct cached_entropy
+    {
+        const std::type_info *type = nullptr;
+        std::uint64_t fingerprint = 0;
+        std::size_t row = 0;
+        double entropy = 0;
+    };
+
+    // The entropy of the values from one call to the store. A span is filled with values of the
+    // distribution, except for a uniform_tuple, whose span holds one value.
+    template <typename Distribution, typename... Args>
+    double output_bits(const Distribution &dist, const Args &...args)
+    {
+        if constexpr (std::is_same_v<Distribution, weighted_table_set>)
+            return entropy_of(dist, args...);
+        else if constexpr (sizeof...(Args) == 1 && !is_uniform_tuple<Distribution>)
+            return (entropy_of(dist) * ... * double(args.size()));
+        else
+            return entropy_of(dist);
+    }
+
+    // Distributions are identified by their parameters rather than their address, so that one
+    // rebuilt at the same address is not mistaken for the last
+    template <typename Distribution> double entropy_of(const Distribution &dist, std::size_t row = 0)
+    {
+        auto key = fingerprint(dist);
+        for (auto &entry : m_entropies)
+            if (entry.fingerprint == key && entry.type == &typeid(Distribution) && entry.row == row)
+                return entry.entropy;
+
+        auto &entry = m_entropies[m_next_entropy++ % m_entropies.size()];
+        entry = {&typeid(Distribution), key, row};
+        if constexpr (std::is_same_v<Distribution, weighted_table_set>)
+            entry.entropy = entropy(dist[row]);
+        else
+            entry.entropy = entropy(dist);
+        return entry.entropy;
+    }
+
+    entropy_telemetry *m_telemetry;
+    std::shared_ptr<entropy_telemetry::counters> m_counters;
+    std::array<cached_entropy, 8> m_entropies;
+    std::size_t m_next_entropy = 0;
+};
+
+// Wraps a store's fetch function to count into a telemetry_instrumentation
+template <typename Fetch> struct telemetry_fetch
+{
+    Fetch fetch;
+    entropy_telemetry::counters *counters;
+
+    template <std::integral uint_t> auto operator()(uint_t U_s, uint_t s) const
+    {
+        telemetry_instrumentation::increment(counters->fetches);
+        return fetch(U_s, s);
+    }
+};
+
+// Only failed samples are counted, as a log2 for every output would double its cost
+template <typename Fetch, std::integral uint_t>
+void note_rejection_sample(const telemetry_fetch<Fetch> &fetch, uint_t before, uint_t after, uint_t accepted)
+{
+    if (!accepted) [[unlikely]]
+    {
+        telemetry_instrumentation::increment(fetch.counters->rejections);
+        telemetry_instrumentation::increment(fetch.counters->discarded_bits, std::log2(double(before) / double(after)));
+    }
+}
+
+} // namespace entropy_store
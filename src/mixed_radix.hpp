@@ -0,0 +1,160 @@
+#pragma once
+
+#include "entropy_store.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <tuple>
+#include <vector>
+
+namespace entropy_store
+{
+// Packs values with small ranges (radices) into 64-bit words by mixed-radix encoding, so that a
+// value with radix r costs close to log2(r) bits rather than a whole number of bits.
+//
+// Values are combined into a word in the same way that entropy_store combines entropy, until the
+// next radix would overflow the word, and then the whole word is written. Each word is therefore
+// short of log2(product) by less than the bits of one value. The first value is the lowest digit
+// of its word, so values decode in the order they were pushed.
+//
+// Every block_size values start a new word, and blocks() gives the word at which each block starts,
+// so that a decoder can seek to any block. The radices are not stored, and the decoder must be
+// given the same radices in the same order.
+class mixed_radix_encoder
+{
+  public:
+    using word_type = std::uint64_t;
+
+    explicit mixed_radix_encoder(std::size_t block_size = 1024) : m_block_size(block_size)
+    {
+        assert(block_size > 0);
+    }
+
+    void push(word_type value, word_type radix)
+    {
+        assert(value < radix);
+        if (m_size % m_block_size == 0)
+        {
+            if (s > 1)
+                write_word();
+            m_blocks.push_back(m_words.size());
+        }
+        if (s > std::numeric_limits<word_type>::max() / radix)
+            write_word();
+        std::tie(U_s, s) = combine(U_s, s, value, radix);
+        ++m_size;
+    }
+
+    // Writes the last partial word. Call this before reading words().
+    void flush()
+    {
+        if (s > 1)
+            write_word();
+    }
+
+    std::span<const word_type> words() const
+    {
+        return m_words;
+    }
+
+    // The index of the first word of each block
+    std::span<const std::size_t> blocks() const
+    {
+        return m_blocks;
+    }
+
+    std::size_t block_size() const
+    {
+        return m_block_size;
+    }
+
+    // The number of values pushed
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    std::size_t bits() const
+    {
+        return 8 * sizeof(word_type) * m_words.size();
+    }
+
+  private:
+    void write_word()
+    {
+        m_words.push_back(U_s);
+        U_s = 0;
+        s = 1;
+    }
+
+    std::size_t m_block_size, m_size = 0;
+    std::vector<word_type> m_words;
+    std::vector<std::size_t> m_blocks;
+    word_type U_s = 0, s = 1;
+};
+
+// Reads values written by a mixed_radix_encoder. The words and blocks are not copied, and must outlive
+// the decoder.
+class mixed_radix_decoder
+{
+  public:
+    using word_type = mixed_radix_encoder::word_type;
+
+    mixed_radix_decoder(std::span<const word_type> words, std::span<const std::size_t> blocks, std::size_t block_size)
+        : m_words(words), m_blocks(blocks), m_block_size(block_size)
+    {
+        assert(block_size > 0);
+    }
+
+    explicit mixed_radix_decoder(const mixed_radix_encoder &encoder)
+        : mixed_radix_decoder(encoder.words(), encoder.blocks(), encoder.block_size())
+    {
+    }
+
+    // Reads the next value, which was pushed with the given radix
+    word_type pop(word_type radix)
+    {
+        if (m_position % m_block_size == 0 && s > 1)
+            s = no_word;
+        if (s > std::numeric_limits<word_type>::max() / radix)
+        {
+            assert(m_next < m_words.size());
+            U_s = m_words[m_next++];
+            s = 1;
+        }
+        word_type value = U_s % radix;
+        U_s /= radix;
+        s *= radix;
+        ++m_position;
+        return value;
+    }
+
+    // Makes the first value of the given block the next one to be read
+    void seek_block(std::size_t block)
+    {
+        assert(block < m_blocks.size());
+        m_next = m_blocks[block];
+        m_position = block * m_block_size;
+        s = no_word;
+    }
+
+    // The index of the next value
+    std::size_t tell() const
+    {
+        return m_position;
+    }
+
+  private:
+    // Forces the next value with a radix above 1 to read a new word
+    static constexpr word_type no_word = std::numeric_limits<word_type>::max();
+
+    std::span<const word_type> m_words;
+    std::span<const std::size_t> m_blocks;
+    std::size_t m_block_size, m_next = 0, m_position = 0;
+    // s is the product of the radices read from the current word
+    word_type U_s = 0, s = no_word;
+};
+
+} // namespace entropy_store
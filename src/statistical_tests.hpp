@@ -0,0 +1,378 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace entropy_store
+{
+// The probability that a chi-squared variable with dof degrees of freedom is at least x. This is
+// the regularized upper incomplete gamma function Q(dof/2, x/2), computed by its series below the
+// mean and by a continued fraction above it.
+inline double chi_squared_p_value(double x, double dof)
+{
+    if (x <= 0)
+        return 1;
+    double a = dof / 2, z = x / 2;
+    double prefix = std::exp(a * std::log(z) - z - std::lgamma(a));
+    if (z < a + 1)
+    {
+        double term = 1 / a, sum = term;
+        for (int n = 1; n < 1000000 && term > sum * 1e-17; ++n)
+        {
+            term *= z / (a + n);
+            sum += term;
+        }
+        return std::max(0.0, 1 - prefix * sum);
+    }
+    constexpr double tiny = 1e-300;
+    double b = z + 1 - a, c = 1 / tiny, d = 1 / b, h = d;
+    for (int i = 1; i < 1000000; ++i)
+    {
+        double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        if (std::abs(d) < tiny)
+            d = tiny;
+        c = b + an / c;
+        if (std::abs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+        h *= d * c;
+        if (std::abs(d * c - 1) < 1e-16)
+            break;
+    }
+    return prefix * h;
+}
+
+// The probability that a standard normal variable is at least |z| from 0
+inline double normal_p_value(double z)
+{
+    return std::erfc(std::abs(z) / std::sqrt(2.0));
+}
+
+struct test_result
+{
+    std::string name;
+    // The chi-squared value, or z for tests with a normal statistic
+    double statistic;
+    double p_value;
+};
+
+// Streaming statistical tests of values from 0 to k-1, against their known probabilities:
+//
+//   frequency  chi-squared test of the count of each value
+//   tuples     chi-squared test of non-overlapping tuples of values, counted in a flat table
+//   serial     lag-1 correlation of consecutive values
+//   runs       the number of times consecutive values change sides of the median
+//   gaps       chi-squared test of the distance between values in the lowest eighth or so
+//
+// Values can be added sequentially, or split into chunks that are tested in parallel and merged
+// in order. Each battery keeps the state at both ends of its values, so merging gives exactly the
+// same counts as testing the values sequentially.
+class test_battery
+{
+  public:
+    using value_type = std::uint32_t;
+
+    // probabilities[i] is the probability of value i. Tuples have tuple_size values or fewer, so
+    // that the table has at most max_tuple_cells cells.
+    explicit test_battery(std::vector<double> probabilities, int tuple_size = 2)
+        : m_probabilities(std::move(probabilities)), m_counts(m_probabilities.size())
+    {
+        assert(!m_probabilities.empty() && tuple_size >= 1);
+        std::size_t cells = m_counts.size();
+        m_tuple_size = 1;
+        while (m_tuple_size < tuple_size && cells * m_counts.size() <= max_tuple_cells)
+        {
+            cells *= m_counts.size();
+            ++m_tuple_size;
+        }
+        if (m_tuple_size > 1)
+            m_tuple_counts.resize(cells);
+
+        double cumulative = 0, best_split = 2, best_gap = 2;
+        for (std::size_t i = 0; i < m_probabilities.size(); ++i)
+        {
+            m_mean += i * m_probabilities[i];
+            m_variance += double(i) * i * m_probabilities[i];
+            cumulative += m_probabilities[i];
+            // Values above i are high for the runs test, and values up to i are hits for the gap test
+            if (i + 1 < m_probabilities.size() && std::abs(cumulative - 0.5) < best_split)
+            {
+                best_split = std::abs(cumulative - 0.5);
+                m_run_split = i + 1;
+                m_high_probability = 1 - cumulative;
+            }
+            if (i + 1 < m_probabilities.size() && std::abs(cumulative - 0.125) < best_gap)
+            {
+                best_gap = std::abs(cumulative - 0.125);
+                m_gap_limit = i + 1;
+                m_hit_probability = cumulative;
+            }
+        }
+        m_variance -= m_mean * m_mean;
+
+        // Gap lengths are grouped into bins of roughly equal probability
+        if (m_hit_probability > 0 && m_hit_probability < 1)
+            for (int j = 1; j < gap_bins; ++j)
+            {
+                auto boundary =
+                    std::uint64_t(std::ceil(std::log(1 - double(j) / gap_bins) / std::log1p(-m_hit_probability)));
+                if (boundary > (m_gap_boundaries.empty() ? 0 : m_gap_boundaries.back()))
+                    m_gap_boundaries.push_back(boundary);
+            }
+        m_gap_counts.resize(m_gap_boundaries.size() + 1);
+    }
+
+    void add(std::span<const value_type> values)
+    {
+        const std::size_t k = m_counts.size();
+        for (auto v : values)
+        {
+            assert(v < k);
+            ++m_counts[v];
+            if (m_tuple_size > 1)
+            {
+                m_tuple = m_tuple * k + v;
+                if (++m_tuple_length == m_tuple_size)
+                {
+                    ++m_tuple_counts[m_tuple];
+                    m_tuple = 0;
+                    m_tuple_length = 0;
+                }
+            }
+            if (m_size > 0)
+            {
+                m_serial += (m_last - m_mean) * (v - m_mean);
+                m_changes += (m_last >= m_run_split) != (v >= m_run_split);
+            }
+            else
+                m_first = v;
+            if (v < m_gap_limit)
+                hit(m_trailing);
+            else
+                ++m_trailing;
+            m_last = v;
+            ++m_size;
+        }
+    }
+
+    // Adds the results of a battery that tested the values following this one's. This battery's
+    // values must be a whole number of tuples.
+    void merge(const test_battery &later)
+    {
+        assert(later.m_counts.size() == m_counts.size() && later.m_tuple_size == m_tuple_size);
+        assert(m_tuple_length == 0);
+        if (later.m_size == 0)
+            return;
+        if (m_size == 0)
+        {
+            *this = later;
+            return;
+        }
+        for (std::size_t i = 0; i < m_counts.size(); ++i)
+            m_counts[i] += later.m_counts[i];
+        for (std::size_t i = 0; i < m_tuple_counts.size(); ++i)
+            m_tuple_counts[i] += later.m_tuple_counts[i];
+        for (std::size_t i = 0; i < m_gap_counts.size(); ++i)
+            m_gap_counts[i] += later.m_gap_counts[i];
+        m_tuple = later.m_tuple;
+        m_tuple_length = later.m_tuple_length;
+        m_serial += later.m_serial + (m_last - m_mean) * (later.m_first - m_mean);
+        m_changes += later.m_changes + ((m_last >= m_run_split) != (later.m_first >= m_run_split));
+        if (later.m_hit)
+        {
+            hit(m_trailing + later.m_leading);
+            m_trailing = later.m_trailing;
+        }
+        else
+            m_trailing += later.m_trailing;
+        m_last = later.m_last;
+        m_size += later.m_size;
+    }
+
+    // Forgets all values, keeping the allocated tables
+    void clear()
+    {
+        std::ranges::fill(m_counts, 0);
+        std::ranges::fill(m_tuple_counts, 0);
+        std::ranges::fill(m_gap_counts, 0);
+        m_tuple = m_tuple_length = 0;
+        m_size = m_changes = m_leading = m_trailing = 0;
+        m_serial = 0;
+        m_hit = false;
+    }
+
+    // The number of values tested
+    std::uint64_t size() const
+    {
+        return m_size;
+    }
+
+    int tuple_size() const
+    {
+        return m_tuple_size;
+    }
+
+    // Tests whose distribution is degenerate, such as runs of a constant, are left out
+    std::vector<test_result> results() const
+    {
+        std::vector<test_result> results;
+        if (m_size == 0)
+            return results;
+
+        results.push_back(
+            chi_squared("frequency", m_counts, m_size, [&](std::size_t i) { return m_probabilities[i]; }));
+
+        if (m_tuple_size > 1 && m_size >= std::uint64_t(m_tuple_size))
+            results.push_back(chi_squared(std::to_string(m_tuple_size) + "-tuples", m_tuple_counts,
+                                          m_size / m_tuple_size, [&](std::size_t cell) {
+                                              double p = 1;
+                                              for (int j = 0; j < m_tuple_size; ++j, cell /= m_counts.size())
+                                                  p *= m_probabilities[cell % m_counts.size()];
+                                              return p;
+                                          }));
+
+        // Centred products of consecutive values have variance sigma^4, and are uncorrelated
+        double pairs = m_size - 1;
+        if (m_variance > 0 && pairs > 0)
+        {
+            double z = m_serial / (m_variance * std::sqrt(pairs));
+            results.push_back({"serial correlation", z, normal_p_value(z)});
+        }
+
+        // A change is 1-dependent on the previous one, and both happen with probability pq
+        double p = m_high_probability, pq = p * (1 - p), c = 2 * pq;
+        if (pq > 0 && pairs > 1)
+        {
+            double variance = pairs * c * (1 - c) + 2 * (pairs - 1) * (pq - c * c);
+            double z = (m_changes - pairs * c) / std::sqrt(variance);
+            results.push_back({"runs", z, normal_p_value(z)});
+        }
+
+        std::uint64_t gaps = 0;
+        for (auto g : m_gap_counts)
+            gaps += g;
+        if (m_gap_boundaries.size() > 0 && gaps > 0)
+        {
+            // The probability that a gap is at least b is (1 - q)^b
+            auto at_least = [&](std::size_t bin) {
+                return bin == 0 ? 1.0 : std::pow(1 - m_hit_probability, double(m_gap_boundaries[bin - 1]));
+            };
+            results.push_back(chi_squared("gaps", m_gap_counts, gaps, [&](std::size_t bin) {
+                return at_least(bin) - (bin < m_gap_boundaries.size() ? at_least(bin + 1) : 0);
+            }));
+        }
+        return results;
+    }
+
+    // Each chunk clears and merges the whole table, which should stay small next to the chunk
+    static constexpr std::size_t max_tuple_cells = 1 << 16;
+
+  private:
+    static constexpr int gap_bins = 16;
+
+    // A value in the gap range after `gap` values that are not
+    void hit(std::uint64_t gap)
+    {
+        if (m_hit)
+            ++m_gap_counts[std::ranges::upper_bound(m_gap_boundaries, gap) - m_gap_boundaries.begin()];
+        else
+        {
+            m_leading = gap;
+            m_hit = true;
+        }
+        m_trailing = 0;
+    }
+
+    // Cells with probability 0 are left out, unless they have a count, which fails the test
+    static test_result chi_squared(std::string name, const std::vector<std::uint64_t> &counts, std::uint64_t total,
+                                   auto probability)
+    {
+        double chi2 = 0, cells = 0;
+        for (std::size_t i = 0; i < counts.size(); ++i)
+        {
+            double expected = total * probability(i);
+            if (expected > 0)
+            {
+                chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+                ++cells;
+            }
+            else if (counts[i] > 0)
+                return {std::move(name), std::numeric_limits<double>::infinity(), 0};
+        }
+        return {std::move(name), chi2, cells > 1 ? chi_squared_p_value(chi2, cells - 1) : 1};
+    }
+
+    std::vector<double> m_probabilities;
+    double m_mean = 0, m_variance = 0;
+    std::vector<std::uint64_t> m_counts;
+
+    int m_tuple_size, m_tuple_length = 0;
+    std::size_t m_tuple = 0;
+    std::vector<std::uint64_t> m_tuple_counts;
+
+    value_type m_run_split = 0, m_gap_limit = 0;
+    double m_high_probability = 0, m_hit_probability = 0;
+    std::vector<std::uint64_t> m_gap_boundaries, m_gap_counts;
+
+    std::uint64_t m_size = 0, m_changes = 0;
+    double m_serial = 0;
+    value_type m_first = 0, m_last = 0;
+    // The number of values before the first hit of the gap test, and since the last one
+    std::uint64_t m_leading = 0, m_trailing = 0;
+    bool m_hit = false;
+};
+
+// Tests `samples` values, where fill(span) writes the next values to the span. The main thread
+// fills chunks while worker threads test the previous ones, and the results of the chunks are
+// merged in order, so the results do not depend on the number of threads.
+inline test_battery run_battery(std::function<void(std::span<test_battery::value_type>)> fill, test_battery battery,
+                                std::uint64_t samples, unsigned threads = std::thread::hardware_concurrency(),
+                                std::size_t chunk_size = 1 << 20)
+{
+    threads = std::max(threads, 1u);
+    chunk_size -= chunk_size % battery.tuple_size();
+    assert(chunk_size > 0);
+    battery.clear();
+
+    std::vector<std::vector<test_battery::value_type>> current(threads), next(threads);
+    std::vector<test_battery> parts(threads, battery);
+    auto fill_chunks = [&](auto &chunks) {
+        for (auto &chunk : chunks)
+        {
+            chunk.resize(std::min<std::uint64_t>(samples, chunk_size));
+            fill(chunk);
+            samples -= chunk.size();
+        }
+    };
+
+    fill_chunks(current);
+    while (!current.front().empty())
+    {
+        {
+            std::vector<std::jthread> workers;
+            for (unsigned i = 0; i < threads; ++i)
+                if (!current[i].empty())
+                    workers.emplace_back([&, i] {
+                        parts[i].clear();
+                        parts[i].add(current[i]);
+                    });
+            fill_chunks(next);
+        }
+        for (unsigned i = 0; i < threads && !current[i].empty(); ++i)
+            battery.merge(parts[i]);
+        std::swap(current, next);
+    }
+    return battery;
+}
+
+} // namespace entropy_store
@@ -11,11 +11,11 @@ extern "C"
 
 namespace entropy_store
 {
-template<typename Source>
+template<typename Source, weighted_table Distribution = weighted_distribution>
 class aldr_source
 {
   public:
-    using distribution_type = weighted_distribution;
+    using distribution_type = Distribution;
     using value_type = int;
     using source_type = fetch_source<Source>;
 
@@ -65,13 +65,16 @@ class aldr_source
     source_type m_source;
 };
 
-template<typename S> 
-    inline double internal_entropy(const aldr_source<S> &)
+template <typename Source, std::integral T>
+aldr_source(Source, const uniform_distribution<T> &) -> aldr_source<Source>;
+
+template<typename S, typename D>
+    inline double internal_entropy(const aldr_source<S, D> &)
 {
     return 0;
 }
 
-template<typename S> int bits_fetched(const aldr_source<S> &s)
+template<typename S, typename D> int bits_fetched(const aldr_source<S, D> &s)
 {
     return bits_fetched(s.source());
 }
@@ -1,42 +1,32 @@
 #include "aldr.hpp"
+#include "bench_harness.hpp"
+#include "chacha.hpp"
+#include "entropy_distributions.hpp"
 #include "entropy_store.hpp"
 #include "fldr.hpp"
 #include "huber_vargas.hpp"
 #include "mt19937.hpp"
+#include "philox.hpp"
 #include "testing.hpp"
 #include "fast_dice_roller.hpp"
 #include "von_neumann.hpp"
 #include "lemire.hpp"
 #include "xoshiro128.hpp"
+#include "xoshiro256pp.hpp"
 
-#include <chrono>
-#include <cstdlib>
-#include <iostream>
+#include <cerrno>
 
-static int grand_total = 0;
+using entropy_store::benchmark::benchmark_name;
+using entropy_store::benchmark::calls;
 
-auto measure(auto generator, entropy_store::distribution auto dist, std::size_t N)
-{
-    int total = 0;
-    auto start_time = std::chrono::high_resolution_clock::now();
-    for (int i = 0; i < N; i++)
-        total += generator(dist);
-    auto end_time = std::chrono::high_resolution_clock::now();
-    grand_total += total;
-    return std::chrono::duration<double>(end_time - start_time) / N;
-}
-
-void report(auto i, auto generator, auto dist, auto source, auto time, auto relative)
-{
-    std::cout << i << ", " << generator << ", " << dist << ", " << source << ", " << time << ", " << (time / relative)
-              << std::endl;
-}
-
-void benchmark_rng(auto source, int i, std::size_t N, const char *source_name)
+void add_benchmarks(entropy_store::benchmark::harness &harness, auto source, const char *source_name)
 {
     auto fetch = entropy_store::bit_generator{source};
     auto es32 = entropy_store::entropy_store32{fetch};
     auto es64 = entropy_store::entropy_store64{fetch};
+    // Fetches at most one 16-bit chunk per output into a reserve of 64 chunks, unless the reserve overruns
+    auto bounded = entropy_store::entropy_store64{
+        entropy_store::reserved_source{entropy_store::chunk_generator<decltype(source), 16>{source}, 64, 1}};
     auto fdr = entropy_store::fast_dice_roller{fetch};
     auto huber_vargas = entropy_store::huber_vargas{fetch};
     auto von_neumann = entropy_store::von_neumann{fetch};
@@ -50,59 +40,135 @@ void benchmark_rng(auto source, int i, std::size_t N, const char *source_name)
     const entropy_store::weighted_distribution weighted{1, 2, 3, 4, 5};
     const entropy_store::weighted_distribution weighted_d6{1, 1, 1, 1, 1, 1}; // FLDR cannot handle weight 0
 
-    measure(es32, d6, N);
-    auto benchmark_d6 = measure(es32, d6, N);
-    measure(es32, bernoulli, N);
-    auto benchmark_bernoulli = measure(es32, bernoulli, N);
-    measure(es32, weighted, N);
-    auto benchmark_weighted = measure(es32, weighted, N);
-
-    report(i, "ES32", "d6", source_name, measure(es32, d6, N), benchmark_d6);
-    report(i, "ES32 optimized", "cd6", source_name, measure(es32, fast_d6, N), benchmark_d6);
-    report(i, "ES64", "d6", source_name, measure(es64, d6, N), benchmark_d6);
-    report(i, "ES64 optimized", "d6", source_name, measure(es64, fast_d6, N), benchmark_d6);
-    report(i, "VN", "d6", source_name, measure(von_neumann, d6, N), benchmark_d6);
-    report(i, "Fast Dice Roller", "d6", source_name, measure(fdr, d6, N), benchmark_d6);
-    report(i, "FLDR", "d6", source_name, measure(entropy_store::fldr_source{fetch, weighted_d6}, weighted_d6, N), benchmark_d6);
-    report(i, "ALDR", "d6", source_name, measure(entropy_store::aldr_source{fetch, weighted_d6}, weighted_d6, N), benchmark_d6);
-    report(i, "Huber-Vargas", "d6", source_name, measure(huber_vargas, d6, N), benchmark_d6);
-
-    report(i, "ES32", "Bernoulli", source_name, measure(es32, bernoulli, N), benchmark_bernoulli);
-    report(i, "ES32 optimized", "Bernoulli", source_name, measure(es32, fast_bernoulli, N), benchmark_bernoulli);
-    report(i, "FLDR", "Bernoulli", source_name, measure(entropy_store::fldr_source{fetch, weighted_bernoulli}, weighted_bernoulli, N),
-           benchmark_bernoulli);
-    report(i, "ALDR", "Bernoulli", source_name, measure(entropy_store::aldr_source{fetch, weighted_bernoulli}, weighted_bernoulli, N),
-           benchmark_bernoulli);
-
-    report(i, "ES32", "Weighted", source_name, measure(es32, weighted, N), benchmark_weighted);
-    report(i, "FLDR", "Weighted", source_name, measure(entropy_store::fldr_source{fetch, weighted}, weighted, N), benchmark_weighted);
-    report(i, "ALDR", "Weighted", source_name, measure(entropy_store::aldr_source{fetch, weighted}, weighted, N), benchmark_weighted);
+    const entropy_store::product_distribution ten_d6{fast_d6, fast_d6, fast_d6, fast_d6, fast_d6,
+                                                     fast_d6, fast_d6, fast_d6, fast_d6, fast_d6};
+    const entropy_store::uniform_tuple<int> ten_runtime_d6{{1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6},
+                                                           {1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6}};
+    const entropy_store::dice_sum_distribution three_d6{3, 6, 2};
+    const entropy_store::dice_sum_distribution ten_d6_sum{10, 6};
+    // The adaptors own a copy of their generator, since benchmarks run after this function returns
+    auto dice = [](auto es, int count, int offset) {
+        return [=](const auto &) mutable {
+            int total = offset;
+            for (int j = 0; j < count; j++)
+                total += es(entropy_store::const_uniform<1, 6>{});
+            return total;
+        };
+    };
+    auto as_product = [](auto es) {
+        return [=](const auto &dist) mutable {
+            return std::apply([](auto... v) { return int((v + ...)); }, es(dist));
+        };
+    };
+    const entropy_store::geometric_distribution gaps{fast_bernoulli};
+    const entropy_store::discrete_gaussian_distribution gaussian3{3}, gaussian20{20}, gaussian1000{1000};
+    const entropy_store::discrete_gaussian_distribution gaussian20_centered{20, 1, 3};
+    const entropy_store::cdt_gaussian_distribution cdt3{3}, cdt20{20}, cdt1000{1000};
+    auto select_each = [](auto es) {
+        return [=, selected = std::vector<std::uint64_t>()](const auto &dist) mutable {
+            selected.clear();
+            for (int j = 0; j < 1000; j++)
+                if (es(dist))
+                    selected.push_back(j);
+            return int(selected.size());
+        };
+    };
+    auto select_gaps = [](auto es) {
+        return [=, selected = std::vector<std::uint64_t>()](const auto &dist) mutable {
+            selected.clear();
+            entropy_store::bernoulli_select(es, 1000, dist, std::back_inserter(selected));
+            return int(selected.size());
+        };
+    };
+    auto as_tuple = [](auto es) {
+        return [=, values = std::vector<int>(10)](const auto &dist) mutable {
+            es(dist, std::span{values});
+            return values[0] + values[9];
+        };
+    };
+    auto add = [&](const char *generator, const char *distribution, auto run, benchmark_name baseline,
+                   double scale = 1) {
+        harness.add({generator, distribution, source_name}, run, baseline, scale);
+    };
+
+    const benchmark_name benchmark_d6{"ES32", "d6"}, benchmark_10d6{"ES32", "10 x cd6"},
+        benchmark_3d6{"ES32", "3 x cd6 + 2"}, benchmark_bernoulli{"ES32", "Bernoulli"},
+        benchmark_select{"ES32", "select 1/100 of 1000"}, benchmark_gaussian{"ES32", "Gaussian sigma=3"},
+        benchmark_weighted{"ES32", "Weighted"};
+
+    add("ES32", "d6", calls(es32, d6), benchmark_d6);
+    add("ES32 optimized", "cd6", calls(es32, fast_d6), benchmark_d6);
+    add("ES64", "d6", calls(es64, d6), benchmark_d6);
+    add("ES64 optimized", "d6", calls(es64, fast_d6), benchmark_d6);
+    add("ES64 bounded", "d6", calls(bounded, d6), benchmark_d6);
+    add("VN", "d6", calls(von_neumann, d6), benchmark_d6);
+    add("Fast Dice Roller", "d6", calls(fdr, d6), benchmark_d6);
+    add("FLDR", "d6", calls(entropy_store::fldr_source{fetch, weighted_d6}, weighted_d6), benchmark_d6);
+    add("ALDR", "d6", calls(entropy_store::aldr_source{fetch, weighted_d6}, weighted_d6), benchmark_d6);
+    add("Huber-Vargas", "d6", calls(huber_vargas, d6), benchmark_d6);
+
+    add("ES32", "10 x cd6", calls(dice(es32, 10, 0), fast_d6), benchmark_10d6);
+    add("ES32 product", "10 x cd6", calls(as_product(es32), ten_d6), benchmark_10d6);
+    add("ES32 uniform_tuple", "10 x d6", calls(as_tuple(es32), ten_runtime_d6), benchmark_10d6);
+    add("ES64", "10 x cd6", calls(dice(es64, 10, 0), fast_d6), benchmark_10d6);
+    add("ES64 product", "10 x cd6", calls(as_product(es64), ten_d6), benchmark_10d6);
+    add("ES64 uniform_tuple", "10 x d6", calls(as_tuple(es64), ten_runtime_d6), benchmark_10d6);
+
+    add("ES32", "3 x cd6 + 2", calls(dice(es32, 3, 2), fast_d6), benchmark_3d6);
+    add("ES32 dice sum", "3d6+2", calls(es32, three_d6), benchmark_3d6);
+    add("ES64", "3 x cd6 + 2", calls(dice(es64, 3, 2), fast_d6), benchmark_3d6);
+    add("ES64 dice sum", "3d6+2", calls(es64, three_d6), benchmark_3d6);
+    add("ES32 dice sum", "10d6", calls(es32, ten_d6_sum), benchmark_10d6);
+    add("ES64 dice sum", "10d6", calls(es64, ten_d6_sum), benchmark_10d6);
+
+    add("ES32", "Bernoulli", calls(es32, bernoulli), benchmark_bernoulli);
+    add("ES32 optimized", "Bernoulli", calls(es32, fast_bernoulli), benchmark_bernoulli);
+    add("ES64 bounded", "Bernoulli", calls(bounded, bernoulli), benchmark_bernoulli);
+    add("FLDR", "Bernoulli", calls(entropy_store::fldr_source{fetch, weighted_bernoulli}, weighted_bernoulli),
+        benchmark_bernoulli);
+    add("ALDR", "Bernoulli", calls(entropy_store::aldr_source{fetch, weighted_bernoulli}, weighted_bernoulli),
+        benchmark_bernoulli);
+
+    // Selecting 1% of 1000 elements
+    add("ES32", "select 1/100 of 1000", calls(select_each(es32), fast_bernoulli), benchmark_select, 0.01);
+    add("ES32 geometric", "select 1/100 of 1000", calls(select_gaps(es32), gaps), benchmark_select, 0.01);
+    add("ES64 geometric", "select 1/100 of 1000", calls(select_gaps(es64), gaps), benchmark_select, 0.01);
+
+    add("ES32", "Gaussian sigma=3", calls(es32, gaussian3), benchmark_gaussian, 0.1);
+    add("ES64", "Gaussian sigma=3", calls(es64, gaussian3), benchmark_gaussian, 0.1);
+    add("ES32", "Gaussian sigma=20", calls(es32, gaussian20), benchmark_gaussian, 0.1);
+    add("ES32", "Gaussian sigma=20 center=1/3", calls(es32, gaussian20_centered), benchmark_gaussian, 0.1);
+    add("ES32", "Gaussian sigma=1000", calls(es32, gaussian1000), benchmark_gaussian, 0.1);
+    add("ES32 CDT", "Gaussian sigma=3", calls(es32, cdt3), benchmark_gaussian, 0.1);
+    add("ES32 CDT", "Gaussian sigma=20", calls(es32, cdt20), benchmark_gaussian, 0.1);
+    add("ES32 CDT", "Gaussian sigma=1000", calls(es32, cdt1000), benchmark_gaussian, 0.001);
+
+    add("ES32", "Weighted", calls(es32, weighted), benchmark_weighted);
+    add("ES64 bounded", "Weighted", calls(bounded, weighted), benchmark_weighted);
+    add("FLDR", "Weighted", calls(entropy_store::fldr_source{fetch, weighted}, weighted), benchmark_weighted);
+    add("ALDR", "Weighted", calls(entropy_store::aldr_source{fetch, weighted}, weighted), benchmark_weighted);
 }
 
 int main(int argc, const char **argv)
 {
+    entropy_store::benchmark::harness harness{argc, argv};
 
-#ifdef NDEBUG
-    std::size_t N = 1000000;
-#else
-    std::cout << "*** Warning: This is a debug build ***\n";
-    std::size_t N = 10000;
-#endif
-
-    // 32-bit sources
+    // Sources
     entropy_store::random_device_generator rd_uncached;
     entropy_store::wrapped_source rd_cached{rd_uncached, 100000};
     entropy_store::mt19937_source mt19937;
     entropy_store::xoshiro128 xoshiro128{rd_uncached};
+    entropy_store::xoshiro256pp xoshiro256pp{rd_uncached};
+    entropy_store::philox4x32 philox{rd_uncached};
+    entropy_store::chacha20 chacha{rd_uncached};
 
-    std::cout << "Iteration, Generator, Distribution, Source, Time per output, Relative time\n";
-    for (int i = 0; i < 3; i++)
-    {
-        benchmark_rng(rd_uncached, i, N, "random_device");
-        // benchmark_rng(rd_cached, i, N, "cached");
-        benchmark_rng(mt19937, i, N, "mt19937");
-        benchmark_rng(xoshiro128, i, N, "xoshiro128");
-    }
-
-    return 0;
-}
\ No newline at end of file
+    add_benchmarks(harness, rd_uncached, "random_device");
+    // add_benchmarks(harness, rd_cached, "cached");
+    add_benchmarks(harness, mt19937, "mt19937");
+    add_benchmarks(harness, xoshiro128, "xoshiro128");
+    add_benchmarks(harness, xoshiro256pp, "xoshiro256pp");
+    add_benchmarks(harness, philox, "philox4x32");
+    add_benchmarks(harness, chacha, "chacha20");
+
+    return harness.run();
+}
@@ -0,0 +1,75 @@
+#include "bench_harness.hpp"
+#include "entropy_distributions.hpp"
+#include "entropy_metrics.hpp"
+#include "xoshiro256pp.hpp"
+
+#include <chrono>
+#include <iostream>
+
+// Bulk base-k digits for tokens, compared with one uniform draw per digit.
+
+void report(std::uint32_t k, const char *method, std::size_t digits, std::size_t bits, double seconds)
+{
+    std::cout << k << ", " << method << ", " << digits / seconds / 1e9 << ", " << double(bits) / digits << std::endl;
+}
+
+template <std::uint32_t K> void measure_per_digit(auto source, std::vector<char> &out)
+{
+    const entropy_store::digit_stream<K> dist;
+    auto converter = entropy_store::entropy_converter64{source, entropy_store::uniform_distribution{0, int(K - 1)}};
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (auto &c : out)
+        c = dist.alphabet()[converter()];
+    auto end_time = std::chrono::high_resolution_clock::now();
+    entropy_store::benchmark::do_not_optimize(out[0]);
+    report(K, "uniform per digit", out.size(), entropy_store::bits_fetched(converter),
+           std::chrono::duration<double>(end_time - start_time).count());
+}
+
+template <std::uint32_t K> void measure_stream(const char *method, auto source, std::vector<char> &out)
+{
+    const entropy_store::digit_stream<K> dist;
+    auto es = entropy_store::entropy_store64{source};
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < out.size(); i += 4096)
+        es(dist, std::span{out}.subspan(i, std::min<std::size_t>(4096, out.size() - i)));
+    auto end_time = std::chrono::high_resolution_clock::now();
+    entropy_store::benchmark::do_not_optimize(out[0]);
+    report(K, method, out.size(), entropy_store::bits_fetched(es),
+           std::chrono::duration<double>(end_time - start_time).count());
+}
+
+template <std::uint32_t K> void measure(entropy_store::xoshiro256pp &prng, std::vector<char> &out)
+{
+    auto bits = entropy_store::counter{entropy_store::bit_generator{prng}};
+    auto chunks = entropy_store::counter{entropy_store::chunk_generator<entropy_store::xoshiro256pp, 16>{prng}};
+    measure_per_digit<K>(bits, out);
+    measure_stream<K>("digit_stream", bits, out);
+    measure_stream<K>("digit_stream 16-bit chunks", chunks, out);
+    prng.jump();
+}
+
+int main()
+{
+#ifdef NDEBUG
+    std::size_t digits = 100000000;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::size_t digits = 1000000;
+#endif
+
+    entropy_store::random_device_generator rd;
+    entropy_store::xoshiro256pp prng{rd};
+    std::vector<char> out(digits);
+
+    std::cout << "Base, Method, GB/s, Bits per digit\n";
+    for (int i = 0; i < 3; i++)
+    {
+        measure<10>(prng, out);
+        measure<16>(prng, out);
+        measure<36>(prng, out);
+        measure<62>(prng, out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "aldr.hpp"
+#include "bench_harness.hpp"
+#include "entropy_metrics.hpp"
+#include "entropy_store.hpp"
+#include "fast_dice_roller.hpp"
+#include "fldr.hpp"
+#include "huber_vargas.hpp"
+#include "lemire.hpp"
+#include "von_neumann.hpp"
+#include "xoshiro128.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+
+// Speed against efficiency for uniform outputs over n values, for each algorithm and buffer size,
+// as a CSV to plot as a Pareto frontier. Bits are counted by wrapping the source in a counter, and
+// the entropy left inside the generator at the end is not counted as consumed.
+//
+// Usage: bench_frontier [max log2 n], where the default is 20.
+
+void measure(const char *method, int buffer_bits, std::size_t n, auto generator, const auto &dist,
+             std::size_t outputs)
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < outputs; i++)
+        entropy_store::benchmark::do_not_optimize(generator(dist));
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    double bits = entropy_store::bits_fetched(generator) - entropy_store::internal_entropy(generator);
+    std::cout << method << ", " << buffer_bits << ", " << n << ", "
+              << 1e9 * std::chrono::duration<double>(end_time - start_time).count() / outputs << ", "
+              << bits / outputs << ", " << outputs * std::log2(double(n)) / bits << std::endl;
+}
+
+// The algorithms that work in a buffer of a given integer type, which each need n <= 2^(bits-2)
+template <typename Buffer> void measure_buffer(auto source, std::size_t n, std::size_t outputs)
+{
+    constexpr int buffer_bits = 8 * sizeof(Buffer);
+    if (n > (std::size_t(1) << std::min(buffer_bits - 2, 63)))
+        return;
+    using unsigned_type = std::make_unsigned_t<Buffer>;
+    const entropy_store::uniform_distribution<int> d(0, n - 1);
+    measure("ES", buffer_bits, n, entropy_store::entropy_store<decltype(source), Buffer>{source}, d, outputs);
+    if constexpr (buffer_bits <= 64)
+    {
+        // These use the integer type of the distribution as their buffer
+        const entropy_store::uniform_distribution<unsigned_type> u(0, n - 1);
+        measure("Fast Dice Roller", buffer_bits, n, entropy_store::fast_dice_roller{source}, u, outputs);
+        measure("Huber-Vargas", buffer_bits, n, entropy_store::huber_vargas{source}, u, outputs);
+        measure("von Neumann", buffer_bits, n, entropy_store::von_neumann{source}, u, outputs);
+    }
+}
+
+int main(int argc, char **argv)
+{
+#ifdef NDEBUG
+    std::size_t outputs = 200000;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::size_t outputs = 2000;
+#endif
+    int max_log_n = argc > 1 ? std::atoi(argv[1]) : 20;
+
+    // Powers of 2, where most algorithms are exact, and values between them, where they are not
+    std::set<std::size_t> ranges;
+    for (int k = 1; k <= max_log_n; k++)
+    {
+        ranges.insert(std::size_t(1) << k);
+        ranges.insert((std::size_t(1) << k) + 1);
+        ranges.insert(std::size_t(3) << (k - 1));
+    }
+    std::erase_if(ranges, [&](auto n) { return n > std::size_t(1) << max_log_n; });
+
+    entropy_store::random_device_generator rd;
+    entropy_store::xoshiro128 prng{rd};
+
+    std::cout << "Generator, Buffer bits, n, ns per output, Bits per output, Efficiency\n";
+    for (auto n : ranges)
+    {
+        auto bits = entropy_store::counter{entropy_store::bit_generator{prng}};
+        measure_buffer<std::uint16_t>(bits, n, outputs);
+        measure_buffer<std::uint32_t>(bits, n, outputs);
+        measure_buffer<std::uint64_t>(bits, n, outputs);
+#ifdef __SIZEOF_INT128__
+        measure_buffer<unsigned __int128>(bits, n, outputs);
+#endif
+        const entropy_store::uniform_distribution<int> d(0, n - 1);
+        measure("Lemire", 64, n, entropy_store::lemire{entropy_store::counter{prng}}, d, outputs);
+        const entropy_store::weighted_distribution weights{d};
+        measure("FLDR", 32, n, entropy_store::fldr_source{bits, weights}, weights, outputs);
+        measure("ALDR", 32, n, entropy_store::aldr_source{bits, weights}, weights, outputs);
+        prng();
+    }
+
+    return 0;
+}
@@ -0,0 +1,560 @@
+#pragma once
+
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// A small benchmark harness: benchmarks are registered by name, filtered from the command line,
+// warmed up and repeated, and reported as CSV in the schema of paper/bench_gcc_x64.csv or as JSON.
+// With --counters, hardware counters per output are added as extra columns. With --latency, each
+// output is timed on its own and percentiles of the latency are reported instead.
+
+namespace entropy_store::benchmark
+{
+// Stops the compiler from discarding a value that is otherwise unused
+template <typename T> inline void do_not_optimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+#endif
+}
+
+struct benchmark_name
+{
+    std::string generator, distribution;
+    // Baselines are named without a source, and take the source of the benchmark that uses them
+    std::string source = {};
+
+    bool operator==(const benchmark_name &) const = default;
+};
+
+// Runs a benchmark for a given number of outputs
+using benchmark_function = std::function<void(std::size_t)>;
+
+// Returns a benchmark_function that calls generator(dist) once per output
+auto calls(auto generator, auto dist)
+{
+    return [generator, dist](std::size_t outputs) mutable {
+        for (std::size_t i = 0; i < outputs; i++)
+            do_not_optimize(generator(dist));
+    };
+}
+
+// Counts latencies in nanoseconds, in buckets within 1/32 of each other, as in HdrHistogram
+class latency_histogram
+{
+  public:
+    void record(std::uint64_t ns)
+    {
+        auto i = bucket(ns);
+        if (i >= m_counts.size())
+            m_counts.resize(i + 1);
+        ++m_counts[i];
+        ++m_total;
+        m_max = std::max(m_max, ns);
+    }
+
+    // The latency that a fraction p of outputs do not exceed, rounded up to the top of its bucket
+    std::uint64_t percentile(double p) const
+    {
+        auto rank = std::uint64_t(std::ceil(p * m_total));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < m_counts.size(); ++i)
+            if ((seen += m_counts[i]) >= std::max<std::uint64_t>(rank, 1))
+                return std::min(lowest(i + 1) - 1, m_max);
+        return m_max;
+    }
+
+    std::uint64_t max() const
+    {
+        return m_max;
+    }
+
+    std::uint64_t count() const
+    {
+        return m_total;
+    }
+
+  private:
+    static constexpr int sub_bits = 5;
+
+    // Values below 2^(sub_bits + 1) have a bucket each, and each power of 2 above has 2^sub_bits
+    static std::size_t bucket(std::uint64_t ns)
+    {
+        if (ns < (2 << sub_bits))
+            return ns;
+        int shift = std::bit_width(ns) - (sub_bits + 1);
+        return ((shift + 1) << sub_bits) + (ns >> shift) - (1 << sub_bits);
+    }
+
+    static std::uint64_t lowest(std::size_t bucket)
+    {
+        if (bucket < (2 << sub_bits))
+            return bucket;
+        int shift = (bucket >> sub_bits) - 1;
+        return ((bucket & ((1 << sub_bits) - 1)) + (1 << sub_bits)) << shift;
+    }
+
+    std::vector<std::uint64_t> m_counts;
+    std::uint64_t m_total = 0, m_max = 0;
+};
+
+class harness
+{
+  public:
+    static constexpr const char *usage = R"(Options:
+  --generator REGEX      only run benchmarks whose generator matches
+  --distribution REGEX   only run benchmarks whose distribution matches
+  --source REGEX         only run benchmarks whose source matches
+  --outputs N            outputs per repetition (default 1000000, or 10000 in a debug build)
+  --warmup N             unreported runs of each benchmark first (default 1)
+  --repetitions N        reported runs of each benchmark (default 3)
+  --cpu N                pin to CPU N
+  --counters             also report hardware counters per output, where available
+  --latency              time each output and report p50, p99, p99.9 and maximum latency
+  --format csv|json      output format (default csv)
+  --output FILE          write results to FILE instead of standard output
+  --list                 list the benchmarks that would run
+  --help                 show this message
+)";
+
+    harness(int argc, const char **argv)
+    {
+#ifndef NDEBUG
+        std::cerr << "*** Warning: This is a debug build ***\n";
+        m_outputs = 10000;
+#endif
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 == argc)
+                    fail("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--generator")
+                m_generator = value();
+            else if (arg == "--distribution")
+                m_distribution = value();
+            else if (arg == "--source")
+                m_source = value();
+            else if (arg == "--outputs")
+                m_outputs = parse<std::size_t>(value());
+            else if (arg == "--warmup")
+                m_warmup = parse<int>(value());
+            else if (arg == "--repetitions")
+                m_repetitions = std::max(1, parse<int>(value()));
+            else if (arg == "--cpu")
+                pin(parse<int>(value()));
+            else if (arg == "--counters")
+                m_counters_enabled = true;
+            else if (arg == "--latency")
+                m_latency = true;
+            else if (arg == "--format")
+            {
+                auto format = value();
+                if (format != "csv" && format != "json")
+                    fail("Unknown format " + format);
+                m_json = format == "json";
+            }
+            else if (arg == "--output")
+                m_output_file = value();
+            else if (arg == "--list")
+                m_list = true;
+            else if (arg == "--help")
+            {
+                std::cout << usage;
+                std::exit(0);
+            }
+            else
+                fail("Unknown option " + arg);
+        }
+    }
+
+    // The number of outputs in each repetition of a benchmark with scale 1
+    std::size_t outputs() const
+    {
+        return m_outputs;
+    }
+
+    // Registers a benchmark. Its relative time is against the benchmark named `baseline` from the same
+    // source, which is run even when it is filtered out. A scale below 1 runs fewer outputs, for slow
+    // benchmarks.
+    void add(benchmark_name name, benchmark_function run, const benchmark_name &baseline, double scale = 1)
+    {
+        auto &b = m_benchmarks.emplace_back(std::move(name), std::move(run));
+        b.baseline = {baseline.generator, baseline.distribution, b.name.source};
+        b.scale = scale;
+    }
+
+    // A benchmark that is its own baseline
+    void add(benchmark_name name, benchmark_function run, double scale = 1)
+    {
+        auto baseline = name;
+        add(std::move(name), std::move(run), baseline, scale);
+    }
+
+    // Runs the selected benchmarks and reports them. Returns the exit status for main().
+    int run()
+    {
+        select();
+        if (m_counters_enabled)
+            open_counters();
+        if (m_list)
+        {
+            for (auto &b : m_benchmarks)
+                if (b.selected)
+                    std::cout << b.name.generator << ", " << b.name.distribution << ", " << b.name.source << "\n";
+            return 0;
+        }
+
+        for (int i = 0; i < m_warmup; i++)
+            for (auto &b : m_benchmarks)
+                if (measured(b))
+                    time(b);
+        // Repetitions are interleaved so that drift affects every benchmark alike
+        for (int i = 0; i < m_repetitions; i++)
+            for (auto &b : m_benchmarks)
+                if (measured(b))
+                {
+                    if (m_latency)
+                        time_outputs(b);
+                    else
+                    {
+                        b.times.push_back(time(b));
+                        b.counts.push_back(read_counters(b));
+                    }
+                }
+
+        std::ofstream file;
+        if (!m_output_file.empty())
+        {
+            file.open(m_output_file);
+            if (!file)
+                fail("Cannot write " + m_output_file);
+        }
+        std::ostream &os = m_output_file.empty() ? std::cout : file;
+        if (m_latency)
+            write_latency(os);
+        else if (m_json)
+            write_json(os);
+        else
+            write_csv(os);
+        return 0;
+    }
+
+  private:
+    struct benchmark
+    {
+        benchmark(benchmark_name n, benchmark_function r) : name(std::move(n)), run(std::move(r))
+        {
+        }
+
+        benchmark_name name, baseline;
+        benchmark_function run;
+        double scale = 1;
+        bool selected = false, is_baseline = false;
+        benchmark *baseline_benchmark = nullptr;
+        std::vector<double> times; // Seconds per output
+        std::vector<std::vector<std::optional<double>>> counts; // Per output, for each repetition and counter
+        latency_histogram latency;
+    };
+
+    struct counter
+    {
+        const char *name, *key;
+        perf_counter events;
+    };
+
+    void open_counters()
+    {
+        m_counters.push_back({"Cycles", "cycles", cycle_counter()});
+        m_counters.push_back({"Instructions", "instructions", instruction_counter()});
+        m_counters.push_back({"Branch misses", "branch_misses", branch_miss_counter()});
+        m_counters.push_back({"L1D misses", "l1d_misses", l1d_miss_counter()});
+        m_counters.push_back({"LLC misses", "llc_misses", llc_miss_counter()});
+        if (std::none_of(m_counters.begin(), m_counters.end(), [](auto &c) { return c.events.valid(); }))
+            std::cerr << "Hardware counters are not available, so they are reported as n/a\n";
+    }
+
+    [[noreturn]] static void fail(const std::string &message)
+    {
+        std::cerr << message << "\n\n" << usage;
+        std::exit(2);
+    }
+
+    template <std::integral T> static T parse(const std::string &value)
+    {
+        T result;
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (error != std::errc{} || end != value.data() + value.size())
+            fail("Invalid number " + value);
+        return result;
+    }
+
+    static std::regex parse_regex(const std::string &pattern)
+    {
+        try
+        {
+            return std::regex(pattern);
+        }
+        catch (const std::regex_error &e)
+        {
+            fail("Invalid regular expression " + pattern + ": " + e.what());
+        }
+    }
+
+    static void pin(int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            std::cerr << "Could not pin to CPU " << cpu << "\n";
+#else
+        std::cerr << "CPU pinning is not supported on this platform\n";
+#endif
+    }
+
+    void select()
+    {
+        auto generator = parse_regex(m_generator), distribution = parse_regex(m_distribution),
+             source = parse_regex(m_source);
+        for (auto &b : m_benchmarks)
+        {
+            b.selected = std::regex_search(b.name.generator, generator) &&
+                         std::regex_search(b.name.distribution, distribution) &&
+                         std::regex_search(b.name.source, source);
+            auto baseline = std::find_if(m_benchmarks.begin(), m_benchmarks.end(),
+                                         [&](const benchmark &other) { return other.name == b.baseline; });
+            if (baseline == m_benchmarks.end())
+                fail("No baseline " + b.baseline.generator + ", " + b.baseline.distribution + " for " +
+                     b.name.generator + ", " + b.name.distribution);
+            b.baseline_benchmark = &*baseline;
+        }
+        for (auto &b : m_benchmarks)
+            if (b.selected)
+                b.baseline_benchmark->is_baseline = true;
+    }
+
+    // Latencies are not relative to a baseline, so baselines only run when they are selected
+    bool measured(const benchmark &b) const
+    {
+        return b.selected || (b.is_baseline && !m_latency);
+    }
+
+    static std::size_t outputs(const benchmark &b, std::size_t outputs)
+    {
+        return std::max<std::size_t>(1, outputs * b.scale);
+    }
+
+    double time(benchmark &b)
+    {
+        auto n = outputs(b, m_outputs);
+        for (auto &c : m_counters)
+            c.events.start();
+        auto start_time = std::chrono::high_resolution_clock::now();
+        b.run(n);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        for (auto &c : m_counters)
+            c.events.stop();
+        return std::chrono::duration<double>(end_time - start_time).count() / n;
+    }
+
+    // Times outputs one at a time. The clock is read twice per output, which costs some nanoseconds
+    // that are included in every latency.
+    void time_outputs(benchmark &b)
+    {
+        auto n = outputs(b, m_outputs);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            b.run(1);
+            auto end_time = std::chrono::steady_clock::now();
+            b.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count());
+        }
+    }
+
+    // The counts from the last run, per output
+    std::vector<std::optional<double>> read_counters(const benchmark &b) const
+    {
+        std::vector<std::optional<double>> counts;
+        for (auto &c : m_counters)
+        {
+            if (c.events.valid())
+                counts.push_back(double(c.events.read()) / outputs(b, m_outputs));
+            else
+                counts.push_back(std::nullopt);
+        }
+        return counts;
+    }
+
+    static std::optional<double> median_count(const benchmark &b, std::size_t counter)
+    {
+        std::vector<double> counts;
+        for (auto &repetition : b.counts)
+            if (repetition[counter])
+                counts.push_back(*repetition[counter]);
+        if (counts.empty())
+            return std::nullopt;
+        return percentile(counts, 0.5);
+    }
+
+    static double percentile(std::vector<double> times, double p)
+    {
+        std::sort(times.begin(), times.end());
+        return times[std::size_t(p * (times.size() - 1) + 0.5)];
+    }
+
+    void write_csv(std::ostream &os) const
+    {
+        os << "Iteration, Generator, Distribution, Source, Time per output, Relative time";
+        for (auto &c : m_counters)
+            os << ", " << c.name << " per output";
+        os << "\n";
+        for (int i = 0; i < m_repetitions; i++)
+            for (auto &b : m_benchmarks)
+                if (b.selected)
+                {
+                    os << i << ", " << b.name.generator << ", " << b.name.distribution << ", " << b.name.source << ", "
+                       << std::chrono::duration<double>(b.times[i]) << ", "
+                       << b.times[i] / b.baseline_benchmark->times[i];
+                    for (auto &count : b.counts[i])
+                    {
+                        if (count)
+                            os << ", " << *count;
+                        else
+                            os << ", n/a";
+                    }
+                    os << "\n";
+                }
+    }
+
+    void write_latency(std::ostream &os) const
+    {
+        if (!m_json)
+            os << "Generator, Distribution, Source, Outputs, p50 ns, p99 ns, p99.9 ns, Max ns\n";
+        else
+            os << "{\n  \"compiler\": " << quote(compiler()) << ",\n  \"debug\": " << (debug ? "true" : "false")
+               << ",\n  \"latency\": [";
+        const char *separator = "\n";
+        for (auto &b : m_benchmarks)
+        {
+            if (!b.selected)
+                continue;
+            auto &l = b.latency;
+            if (!m_json)
+                os << b.name.generator << ", " << b.name.distribution << ", " << b.name.source << ", " << l.count()
+                   << ", " << l.percentile(0.5) << ", " << l.percentile(0.99) << ", " << l.percentile(0.999) << ", "
+                   << l.max() << "\n";
+            else
+                os << separator << "    {\"generator\": " << quote(b.name.generator)
+                   << ", \"distribution\": " << quote(b.name.distribution) << ", \"source\": " << quote(b.name.source)
+                   << ", \"outputs\": " << l.count() << ",\n     \"p50\": " << l.percentile(0.5)
+                   << ", \"p99\": " << l.percentile(0.99) << ", \"p99.9\": " << l.percentile(0.999)
+                   << ", \"max\": " << l.max() << "}";
+            separator = ",\n";
+        }
+        if (m_json)
+            os << "\n  ]\n}\n";
+    }
+
+    static std::string quote(const std::string &s)
+    {
+        std::string result = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + "\"";
+    }
+
+    void write_json(std::ostream &os) const
+    {
+        os << "{\n  \"compiler\": " << quote(compiler()) << ",\n  \"debug\": " << (debug ? "true" : "false")
+           << ",\n  \"outputs\": " << m_outputs << ",\n  \"warmup\": " << m_warmup
+           << ",\n  \"repetitions\": " << m_repetitions << ",\n  \"benchmarks\": [";
+        const char *separator = "\n";
+        for (auto &b : m_benchmarks)
+        {
+            if (!b.selected)
+                continue;
+            auto median = percentile(b.times, 0.5);
+            os << separator << "    {\"generator\": " << quote(b.name.generator)
+               << ", \"distribution\": " << quote(b.name.distribution) << ", \"source\": " << quote(b.name.source)
+               << ", \"outputs\": " << outputs(b, m_outputs) << ",\n     \"times\": [";
+            for (std::size_t i = 0; i < b.times.size(); i++)
+                os << (i ? ", " : "") << b.times[i];
+            os << "],\n     \"median\": " << median << ", \"p10\": " << percentile(b.times, 0.1)
+               << ", \"p90\": " << percentile(b.times, 0.9)
+               << ", \"relative\": " << median / percentile(b.baseline_benchmark->times, 0.5);
+            if (!m_counters.empty())
+            {
+                os << ",\n     \"counters\": {";
+                for (std::size_t c = 0; c < m_counters.size(); c++)
+                {
+                    os << (c ? ", " : "") << "\"" << m_counters[c].key << "\": ";
+                    if (auto count = median_count(b, c))
+                        os << *count;
+                    else
+                        os << "null";
+                }
+                os << "}";
+            }
+            os << "}";
+            separator = ",\n";
+        }
+        os << "\n  ]\n}\n";
+    }
+
+    static std::string compiler()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+#else
+        return "unknown";
+#endif
+    }
+
+#ifdef NDEBUG
+    static constexpr bool debug = false;
+#else
+    static constexpr bool debug = true;
+#endif
+
+    std::vector<benchmark> m_benchmarks;
+    std::vector<counter> m_counters;
+    std::string m_generator, m_distribution, m_source, m_output_file;
+    std::size_t m_outputs = 1000000;
+    int m_warmup = 1, m_repetitions = 3;
+    bool m_json = false, m_list = false, m_counters_enabled = false, m_latency = false;
+};
+
+} // namespace entropy_store::benchmark
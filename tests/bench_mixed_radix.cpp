@@ -0,0 +1,116 @@
+#include "bench_harness.hpp"
+#include "mixed_radix.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// Packing records of small-range fields, compared with packing each field into a whole number of bits.
+
+// Each value takes bit_width(radix - 1) bits, and values may straddle two words
+class bit_packer
+{
+  public:
+    void push(std::uint64_t value, std::uint64_t radix)
+    {
+        int width = std::bit_width(radix - 1);
+        if (m_used == 0)
+            m_words.push_back(0);
+        m_words.back() |= value << m_used;
+        if (m_used + width >= 64)
+        {
+            m_used += width - 64;
+            if (m_used > 0)
+                m_words.push_back(value >> (width - m_used));
+        }
+        else
+            m_used += width;
+    }
+
+    std::uint64_t pop(std::uint64_t radix)
+    {
+        int width = std::bit_width(radix - 1);
+        std::uint64_t value = m_words[m_next] >> m_read;
+        if (m_read + width >= 64)
+        {
+            ++m_next;
+            m_read += width - 64;
+            if (m_read > 0)
+                value |= m_words[m_next] << (width - m_read);
+        }
+        else
+            m_read += width;
+        return value & ((std::uint64_t(1) << width) - 1);
+    }
+
+    std::size_t bits() const
+    {
+        return 64 * m_words.size();
+    }
+
+  private:
+    std::vector<std::uint64_t> m_words;
+    int m_used = 0, m_read = 0;
+    std::size_t m_next = 0;
+};
+
+void report(const char *method, std::size_t values, std::size_t bits, double encode_seconds, double decode_seconds)
+{
+    std::cout << method << ", " << double(bits) / values << ", " << values / encode_seconds << ", "
+              << values / decode_seconds << std::endl;
+}
+
+void measure(const char *method, const std::vector<std::uint64_t> &values, const std::vector<std::uint64_t> &radices,
+             auto encoder, auto make_decoder)
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < values.size(); ++i)
+        encoder.push(values[i], radices[i]);
+    if constexpr (requires { encoder.flush(); })
+        encoder.flush();
+    auto mid_time = std::chrono::high_resolution_clock::now();
+    auto bits = encoder.bits();
+    auto decoder = make_decoder(encoder);
+    for (std::size_t i = 0; i < values.size(); ++i)
+        entropy_store::benchmark::do_not_optimize(decoder.pop(radices[i]));
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    report(method, values.size(), bits, std::chrono::duration<double>(mid_time - start_time).count(),
+           std::chrono::duration<double>(end_time - mid_time).count());
+}
+
+int main()
+{
+#ifdef NDEBUG
+    std::size_t values = 100000000;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::size_t values = 1000000;
+#endif
+
+    // Records of four enum fields
+    std::mt19937 mt;
+    std::vector<std::uint64_t> radices(values), data(values);
+    double optimal = 0;
+    for (std::size_t i = 0; i < values; ++i)
+    {
+        radices[i] = std::array{3, 5, 6, 10}[i % 4];
+        data[i] = mt() % radices[i];
+        optimal += std::log2(radices[i]);
+    }
+
+    std::cout << "Method, Bits per value, Values encoded per second, Values decoded per second\n";
+    std::cout << "log2(product), " << optimal / values << ", n/a, n/a\n";
+    for (int i = 0; i < 3; i++)
+    {
+        measure("bit packing", data, radices, bit_packer{}, [](bit_packer &p) { return std::move(p); });
+        measure("mixed radix", data, radices, entropy_store::mixed_radix_encoder{},
+                [](const auto &e) { return entropy_store::mixed_radix_decoder{e}; });
+        measure("mixed radix 64-value blocks", data, radices, entropy_store::mixed_radix_encoder{64},
+                [](const auto &e) { return entropy_store::mixed_radix_decoder{e}; });
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "bench_harness.hpp"
+#include "entropy_distributions.hpp"
+#include "xoshiro128.hpp"
+
+#include <chrono>
+#include <iostream>
+
+// Reservoir sampling from a synthetic stream of records.
+// Compares one uniform draw per record with skips drawn from the store.
+
+void measure(const char *method, std::size_t k, std::uint64_t records, auto sample)
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+    entropy_store::benchmark::do_not_optimize(sample(k, records));
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::cout << method << ", " << k << ", " << records << ", "
+              << records / std::chrono::duration<double>(end_time - start_time).count() << std::endl;
+}
+
+int main()
+{
+#ifdef NDEBUG
+    std::uint64_t records = 1000000000, naive_records = 10000000;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::uint64_t records = 1000000, naive_records = 100000;
+#endif
+
+    entropy_store::random_device_generator rd;
+    auto fetch = entropy_store::bit_generator{entropy_store::xoshiro128{rd}};
+    auto es = entropy_store::entropy_store64{fetch};
+
+    // One uniform draw per record (Algorithm R)
+    auto naive = [&](std::size_t k, std::uint64_t n) {
+        std::vector<std::uint64_t> samples;
+        for (std::uint64_t r = 0; r < n; r++)
+        {
+            if (r < k)
+                samples.push_back(r);
+            else if (auto i = es(entropy_store::uniform_distribution<std::uint64_t>{0, r}); i < k)
+                samples[i] = r;
+        }
+        return samples[0];
+    };
+
+    // Every record is pushed, but skipped records cost no entropy
+    auto push = [&](std::size_t k, std::uint64_t n) {
+        entropy_store::reservoir_sampler<std::uint64_t> sampler(k);
+        for (std::uint64_t r = 0; r < n; r++)
+            sampler.push(es, r);
+        return sampler.samples()[0];
+    };
+
+    // Skipped records are not read at all
+    auto discard = [&](std::size_t k, std::uint64_t n) {
+        entropy_store::reservoir_sampler<std::uint64_t> sampler(k);
+        while (sampler.count() < n)
+        {
+            sampler.discard(std::min(sampler.skip(), n - sampler.count()));
+            if (sampler.count() < n)
+                sampler.push(es, sampler.count());
+        }
+        return sampler.samples()[0];
+    };
+
+    std::cout << "Method, k, Records, Records per second\n";
+    for (int i = 0; i < 3; i++)
+    {
+        for (std::size_t k : {10, 1000})
+        {
+            measure("uniform per record", k, naive_records, naive);
+            measure("reservoir_sampler push", k, records, push);
+            measure("reservoir_sampler discard", k, records, discard);
+        }
+    }
+
+    return 0;
+}
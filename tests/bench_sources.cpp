@@ -0,0 +1,96 @@
+#include "bench_harness.hpp"
+#include "entropy_store.hpp"
+#include "chacha.hpp"
+#include "mmap_source.hpp"
+#include "mt19937.hpp"
+#include "philox.hpp"
+#include "xoshiro128.hpp"
+#include "xoshiro128x8.hpp"
+#include "testing.hpp"
+#include "xoshiro256pp.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Raw throughput of each entropy source, one value per call compared with bulk fill() where
+// the source supports it. A capture replayed from a mapped file is compared with the same words
+// cached in memory.
+
+void report(const char *source, const char *method, std::size_t bytes, auto start_time, auto end_time)
+{
+    std::cout << source << ", " << method << ", "
+              << bytes / std::chrono::duration<double>(end_time - start_time).count() / 1e9 << std::endl;
+}
+
+template <entropy_store::entropy_generator Source>
+void measure(const char *name, Source source, std::size_t bytes)
+{
+    using value_type = typename Source::value_type;
+    std::vector<value_type> values(4096);
+    std::size_t count = bytes / sizeof(value_type);
+    std::uint64_t total = 0;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < count; i++)
+        total += source();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    report(name, "operator()", count * sizeof(value_type), start_time, end_time);
+
+    if constexpr (entropy_store::bulk_entropy_generator<Source>)
+    {
+        start_time = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < count; i += values.size())
+        {
+            source.fill(std::span{values});
+            total += values[0];
+        }
+        end_time = std::chrono::high_resolution_clock::now();
+        report(name, "fill", count * sizeof(value_type), start_time, end_time);
+    }
+    entropy_store::benchmark::do_not_optimize(total);
+}
+
+int main()
+{
+#ifdef NDEBUG
+    std::size_t bytes = 1 << 28;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::size_t bytes = 1 << 22;
+#endif
+
+    entropy_store::random_device_generator rd;
+
+    // A recorded capture, written once and replayed in each iteration
+    std::size_t capture_bytes = bytes / 4;
+    auto capture_path = (std::filesystem::temp_directory_path() / "entropy_store_bench_capture.bin").string();
+    entropy_store::xoshiro256pp capture_source{rd};
+    {
+        std::vector<std::uint64_t> capture(capture_bytes / sizeof(std::uint64_t));
+        capture_source.fill(std::span{capture});
+        std::ofstream file(capture_path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(capture.data()), capture_bytes);
+    }
+    entropy_store::mmap_entropy_source<std::uint64_t> capture{capture_path};
+    entropy_store::wrapped_source cached{capture, capture.size()};
+
+    std::cout << "Source, Method, GB/s\n";
+    for (int i = 0; i < 3; i++)
+    {
+        measure("random_device", rd, bytes >> 8);
+        measure("mt19937", entropy_store::mt19937_source{}, bytes);
+        measure("xoshiro128", entropy_store::xoshiro128{rd}, bytes);
+        measure("xoshiro128x8", entropy_store::xoshiro128x8{rd}, bytes);
+        measure("xoshiro256pp", entropy_store::xoshiro256pp{rd}, bytes);
+        measure("philox4x32", entropy_store::philox4x32{rd}, bytes);
+        measure("chacha20", entropy_store::chacha20{rd}, bytes);
+        measure("mmap capture", capture, capture_bytes);
+        measure("wrapped_source capture", cached, capture_bytes);
+    }
+    std::filesystem::remove(capture_path);
+
+    return 0;
+}
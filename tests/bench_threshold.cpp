@@ -0,0 +1,86 @@
+#include "bench_harness.hpp"
+#include "entropy_analysis.hpp"
+#include "entropy_metrics.hpp"
+#include "entropy_store.hpp"
+#include "xoshiro128.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Speed against efficiency for each refill policy of entropy_store, as a CSV to plot the trade-off
+// between them. Each row also gives the loss per output that the policy bounds, and the loss that
+// entropy_analysis predicts, to compare with the bits measured.
+//
+// Usage: bench_threshold
+
+template <typename RefillPolicy, typename Buffer>
+void measure(const char *policy, const char *source_name, auto source, const char *distribution, const auto &dist,
+             const std::vector<std::uint32_t> &weights, std::size_t outputs)
+{
+    entropy_store::entropy_store<decltype(source), Buffer, entropy_store::no_instrumentation, RefillPolicy> store{
+        source};
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < outputs; i++)
+        entropy_store::benchmark::do_not_optimize(store(dist));
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::uint64_t n = 0;
+    for (auto w : weights)
+        n += w;
+    auto config = entropy_store::refilling_by<RefillPolicy>(
+        entropy_store::configuration_of<Buffer>(source.distribution()), n);
+    auto predicted = entropy_store::estimate_weighted(config, weights, 100000);
+
+    double bits = entropy_store::bits_fetched(store) - entropy_store::internal_entropy(store);
+    std::cout << policy << ", " << 8 * sizeof(Buffer) << ", " << source_name << ", " << distribution << ", "
+              << 1e9 * std::chrono::duration<double>(end_time - start_time).count() / outputs << ", "
+              << bits / outputs << ", " << predicted.output_bits * outputs / bits << ", "
+              << entropy_store::worst_case_loss(n, config) << ", " << predicted.lost_bits << std::endl;
+}
+
+template <typename RefillPolicy, typename Buffer>
+void measure_policy(const char *policy, const char *source_name, auto source, std::size_t outputs)
+{
+    measure<RefillPolicy, Buffer>(policy, source_name, source, "d6", entropy_store::uniform_distribution{1, 6},
+                                  {1, 1, 1, 1, 1, 1}, outputs);
+    measure<RefillPolicy, Buffer>(policy, source_name, source, "Bernoulli 1/3",
+                                  entropy_store::bernoulli_distribution{1, 3}, {2, 1}, outputs);
+    measure<RefillPolicy, Buffer>(policy, source_name, source, "Weighted 1:2:3:4",
+                                  entropy_store::weighted_distribution{1, 2, 3, 4}, {1, 2, 3, 4}, outputs);
+}
+
+template <typename Buffer> void measure_buffer(const char *source_name, auto source, std::size_t outputs)
+{
+    measure_policy<entropy_store::max_efficiency, Buffer>("Max efficiency", source_name, source, outputs);
+    measure_policy<entropy_store::target_loss<16>, Buffer>("Target loss 16", source_name, source, outputs);
+    measure_policy<entropy_store::target_loss<8>, Buffer>("Target loss 8", source_name, source, outputs);
+    measure_policy<entropy_store::target_loss<4>, Buffer>("Target loss 4", source_name, source, outputs);
+    measure_policy<entropy_store::target_loss<2>, Buffer>("Target loss 2", source_name, source, outputs);
+    measure_policy<entropy_store::max_throughput, Buffer>("Max throughput", source_name, source, outputs);
+}
+
+int main()
+{
+#ifdef NDEBUG
+    std::size_t outputs = 2000000;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::size_t outputs = 20000;
+#endif
+
+    entropy_store::random_device_generator rd;
+    entropy_store::xoshiro128 prng{rd};
+    auto bits = entropy_store::counter{entropy_store::bit_generator{prng}};
+    auto chunks = entropy_store::counter{entropy_store::chunk_generator<decltype(prng), 16>{prng}};
+
+    std::cout << "Policy, Buffer bits, Source, Distribution, ns per output, Bits per output, Efficiency, Loss bound, "
+                 "Predicted loss\n";
+    measure_buffer<std::uint32_t>("Bits", bits, outputs);
+    measure_buffer<std::uint64_t>("Bits", bits, outputs);
+    measure_buffer<std::uint32_t>("16-bit chunks", chunks, outputs);
+    measure_buffer<std::uint64_t>("16-bit chunks", chunks, outputs);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "bench_harness.hpp"
+#include "entropy_store.hpp"
+#include "perf_counters.hpp"
+#include "xoshiro128.hpp"
+
+#include <chrono>
+#include <iostream>
+
+// Random walk on a Markov chain with many states, each with a small weighted transition table.
+// Compares one weighted_distribution per state with a single weighted_table_set.
+
+void measure(const char *method, std::size_t states, std::size_t steps, auto step)
+{
+    auto misses = entropy_store::cache_miss_counter();
+    std::uint32_t state = 0;
+    misses.start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < steps; i++)
+        state = step(state);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    misses.stop();
+    entropy_store::benchmark::do_not_optimize(state);
+
+    std::cout << method << ", " << states << ", " << steps / std::chrono::duration<double>(end_time - start_time).count()
+              << ", ";
+    if (misses.valid())
+        std::cout << double(misses.read()) / steps;
+    else
+        std::cout << "n/a";
+    std::cout << std::endl;
+}
+
+int main()
+{
+#ifdef NDEBUG
+    std::size_t states = 500000, steps = 10000000;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::size_t states = 5000, steps = 100000;
+#endif
+
+    // Build a random chain with 2-8 successors per state
+    std::mt19937 mt;
+    std::vector<entropy_store::weighted_distribution> tables;
+    std::vector<std::vector<std::uint32_t>> successors(states);
+    entropy_store::weighted_table_set table_set;
+    std::vector<std::uint32_t> flat_successors, successor_start;
+    for (std::size_t i = 0; i < states; i++)
+    {
+        std::vector<std::uint32_t> weights(2 + mt() % 7);
+        for (auto &w : weights)
+        {
+            w = 1 + mt() % 16;
+            successors[i].push_back(mt() % states);
+        }
+        tables.emplace_back(weights);
+        table_set.add(weights);
+        successor_start.push_back(flat_successors.size());
+        flat_successors.insert(flat_successors.end(), successors[i].begin(), successors[i].end());
+    }
+
+    entropy_store::random_device_generator rd;
+    auto fetch = entropy_store::bit_generator{entropy_store::xoshiro128{rd}};
+    auto es = entropy_store::entropy_store32{fetch};
+
+    std::cout << "Method, States, Steps per second, Cache misses per step\n";
+    for (int i = 0; i < 3; i++)
+    {
+        measure("vector<weighted_distribution>", states, steps,
+                [&](std::uint32_t state) { return successors[state][es(tables[state])]; });
+        measure("weighted_table_set", states, steps, [&](std::uint32_t state) {
+            return flat_successors[successor_start[state] + es(table_set, state)];
+        });
+    }
+
+    return 0;
+}
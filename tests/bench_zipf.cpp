@@ -0,0 +1,50 @@
+#include "bench_harness.hpp"
+#include "entropy_distributions.hpp"
+#include "entropy_metrics.hpp"
+#include "xoshiro128.hpp"
+
+#include <chrono>
+#include <iostream>
+
+// Zipf-distributed keys over supports too large for a weighted_distribution,
+// for several exponents.
+
+void measure(auto &es, const entropy_store::zipf_distribution &dist, std::size_t samples)
+{
+    auto bits_before = entropy_store::bits_fetched(es);
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < samples; i++)
+        entropy_store::benchmark::do_not_optimize(es(dist));
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto bits = entropy_store::bits_fetched(es) - bits_before;
+
+    std::cout << dist.n() << ", " << dist.exponent() << ", "
+              << 1e9 * std::chrono::duration<double>(end_time - start_time).count() / samples << ", "
+              << double(bits) / samples << std::endl;
+}
+
+int main()
+{
+#ifdef NDEBUG
+    std::size_t samples = 10000000;
+#else
+    std::cout << "*** Warning: This is a debug build ***\n";
+    std::size_t samples = 100000;
+#endif
+
+    entropy_store::random_device_generator rd;
+    auto fetch = entropy_store::counter{entropy_store::bit_generator{entropy_store::xoshiro128{rd}}};
+    auto es = entropy_store::entropy_store64{fetch};
+
+    std::cout << "Keys, Exponent, ns per sample, Bits per sample\n";
+    for (int i = 0; i < 3; i++)
+    {
+        for (double exponent : {0.5, 0.99, 1.0, 1.2, 2.0})
+        {
+            measure(es, entropy_store::zipf_distribution{1000000000, exponent}, samples);
+            measure(es, entropy_store::zipf_distribution{1000, exponent}, samples);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace entropy_store
+{
+// ChaCha20 (Bernstein) as a random number generator, with a 64-bit block counter and a
+// 64-bit stream id in place of the nonce. As with philox4x32, seek() gives random access
+// within a stream and split() gives non-overlapping streams with the same key.
+// Blocks are generated `lanes` at a time, using AVX2 when it is available, and otherwise
+// in a layout that compilers can vectorize.
+class chacha20
+{
+  public:
+    using value_type = std::uint32_t;
+    using distribution_type = const_uniform_distribution<value_type, std::numeric_limits<value_type>::min(),
+                                                         std::numeric_limits<value_type>::max()>;
+    using key_type = std::array<std::uint32_t, 8>;
+
+#ifdef __AVX2__
+    static constexpr std::size_t lanes = 8;
+#else
+    static constexpr std::size_t lanes = 4;
+#endif
+    static constexpr std::size_t words_per_block = 16;
+
+    explicit chacha20(const key_type &key = {}, std::uint64_t stream = 0) : m_key(key), m_stream(stream)
+    {
+        refill();
+    }
+
+    template <entropy_generator Seed>
+        requires(!std::is_same_v<Seed, chacha20>)
+    chacha20(Seed &seed)
+    {
+        for (auto &k : m_key)
+            k = seed();
+        refill();
+    }
+
+    constexpr distribution_type distribution() const
+    {
+        return {};
+    }
+
+    constexpr value_type min() const
+    {
+        return 0;
+    }
+    constexpr value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+    value_type operator()()
+    {
+        if (m_index == m_buffer.size())
+        {
+            m_block += lanes;
+            refill();
+            m_index = 0;
+        }
+        return m_buffer[m_index++];
+    }
+
+    void fill(std::span<value_type> words)
+    {
+        for (auto out = words.begin(); out != words.end();)
+        {
+            if (m_index == m_buffer.size())
+            {
+                m_block += lanes;
+                refill();
+                m_index = 0;
+            }
+            auto n = std::min<std::size_t>(m_buffer.size() - m_index, words.end() - out);
+            out = std::copy_n(m_buffer.begin() + m_index, n, out);
+            m_index += n;
+        }
+    }
+
+    int bits() const
+    {
+        return 32;
+    }
+
+    // Moves to the given output word in the current stream
+    void seek(std::uint64_t offset)
+    {
+        m_block = offset / m_buffer.size() * lanes;
+        refill();
+        m_index = offset % m_buffer.size();
+    }
+
+    // The number of words output so far in the current stream
+    std::uint64_t tell() const
+    {
+        return m_block * words_per_block + m_index;
+    }
+
+    // A generator with the same key, positioned at the start of another stream
+    chacha20 split(std::uint64_t stream) const
+    {
+        auto result = *this;
+        result.m_stream = stream;
+        result.seek(0);
+        return result;
+    }
+
+    std::uint64_t stream() const
+    {
+        return m_stream;
+    }
+
+  private:
+    static std::uint32_t rotl(std::uint32_t x, int k)
+    {
+        return (x << k) | (x >> (32 - k));
+    }
+
+#ifdef __AVX2__
+    static __m256i rotl(__m256i x, int k)
+    {
+        return _mm256_or_si256(_mm256_slli_epi32(x, k), _mm256_srli_epi32(x, 32 - k));
+    }
+
+    void refill()
+    {
+        // x[word] holds that word of all 8 blocks
+        alignas(32) std::uint32_t low[lanes], high[lanes];
+        for (std::size_t i = 0; i < lanes; ++i)
+        {
+            low[i] = std::uint32_t(m_block + i);
+            high[i] = std::uint32_t((m_block + i) >> 32);
+        }
+
+        __m256i input[16], x[16];
+        input[0] = _mm256_set1_epi32(0x61707865);
+        input[1] = _mm256_set1_epi32(0x3320646e);
+        input[2] = _mm256_set1_epi32(0x79622d32);
+        input[3] = _mm256_set1_epi32(0x6b206574);
+        for (int k = 0; k < 8; ++k)
+            input[4 + k] = _mm256_set1_epi32(m_key[k]);
+        input[12] = _mm256_load_si256(reinterpret_cast<const __m256i *>(low));
+        input[13] = _mm256_load_si256(reinterpret_cast<const __m256i *>(high));
+        input[14] = _mm256_set1_epi32(std::uint32_t(m_stream));
+        input[15] = _mm256_set1_epi32(std::uint32_t(m_stream >> 32));
+        std::copy(input, input + 16, x);
+
+        auto quarter_round = [&](int a, int b, int c, int d) {
+            x[a] = _mm256_add_epi32(x[a], x[b]);
+            x[d] = rotl(_mm256_xor_si256(x[d], x[a]), 16);
+            x[c] = _mm256_add_epi32(x[c], x[d]);
+            x[b] = rotl(_mm256_xor_si256(x[b], x[c]), 12);
+            x[a] = _mm256_add_epi32(x[a], x[b]);
+            x[d] = rotl(_mm256_xor_si256(x[d], x[a]), 8);
+            x[c] = _mm256_add_epi32(x[c], x[d]);
+            x[b] = rotl(_mm256_xor_si256(x[b], x[c]), 7);
+        };
+
+        for (int round = 0; round < 10; ++round)
+        {
+            quarter_round(0, 4, 8, 12);
+            quarter_round(1, 5, 9, 13);
+            quarter_round(2, 6, 10, 14);
+            quarter_round(3, 7, 11, 15);
+            quarter_round(0, 5, 10, 15);
+            quarter_round(1, 6, 11, 12);
+            quarter_round(2, 7, 8, 13);
+            quarter_round(3, 4, 9, 14);
+        }
+
+        alignas(32) std::uint32_t words[16][lanes];
+        for (int w = 0; w < 16; ++w)
+            _mm256_store_si256(reinterpret_cast<__m256i *>(words[w]), _mm256_add_epi32(x[w], input[w]));
+        for (std::size_t i = 0; i < lanes; ++i)
+            for (int w = 0; w < 16; ++w)
+                m_buffer[i * words_per_block + w] = words[w][i];
+    }
+#else
+    void refill()
+    {
+        // x[word][lane]
+        std::uint32_t input[16][lanes], x[16][lanes];
+        for (std::size_t i = 0; i < lanes; ++i)
+        {
+            std::uint64_t block = m_block + i;
+            input[0][i] = 0x61707865;
+            input[1][i] = 0x3320646e;
+            input[2][i] = 0x79622d32;
+            input[3][i] = 0x6b206574;
+            for (int k = 0; k < 8; ++k)
+                input[4 + k][i] = m_key[k];
+            input[12][i] = std::uint32_t(block);
+            input[13][i] = std::uint32_t(block >> 32);
+            input[14][i] = std::uint32_t(m_stream);
+            input[15][i] = std::uint32_t(m_stream >> 32);
+        }
+        std::copy(&input[0][0], &input[0][0] + 16 * lanes, &x[0][0]);
+
+        auto quarter_round = [&](int a, int b, int c, int d) {
+            for (std::size_t i = 0; i < lanes; ++i)
+            {
+                x[a][i] += x[b][i];
+                x[d][i] = rotl(x[d][i] ^ x[a][i], 16);
+                x[c][i] += x[d][i];
+                x[b][i] = rotl(x[b][i] ^ x[c][i], 12);
+                x[a][i] += x[b][i];
+                x[d][i] = rotl(x[d][i] ^ x[a][i], 8);
+                x[c][i] += x[d][i];
+                x[b][i] = rotl(x[b][i] ^ x[c][i], 7);
+            }
+        };
+
+        for (int round = 0; round < 10; ++round)
+        {
+            quarter_round(0, 4, 8, 12);
+            quarter_round(1, 5, 9, 13);
+            quarter_round(2, 6, 10, 14);
+            quarter_round(3, 7, 11, 15);
+            quarter_round(0, 5, 10, 15);
+            quarter_round(1, 6, 11, 12);
+            quarter_round(2, 7, 8, 13);
+            quarter_round(3, 4, 9, 14);
+        }
+
+        for (std::size_t i = 0; i < lanes; ++i)
+            for (int w = 0; w < 16; ++w)
+                m_buffer[i * words_per_block + w] = x[w][i] + input[w][i];
+    }
+#endif
+
+    key_type m_key{};
+    std::uint64_t m_stream = 0, m_block = 0;
+    std::array<std::uint32_t, lanes * words_per_block> m_buffer;
+    std::size_t m_index = 0;
+};
+
+inline double internal_entropy(const chacha20 &)
+{
+    return 0;
+}
+
+} // namespace entropy_store
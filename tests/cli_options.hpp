@@ -0,0 +1,100 @@
+#pragma once
+
+#include "entropy_store.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Option parsing shared by the command-line tools. Errors throw std::invalid_argument, which each
+// tool reports with its usage text.
+
+namespace entropy_store::cli
+{
+// Distributions given on the command line have at most this many outcomes
+constexpr std::uint64_t max_outcomes = 1 << 23;
+
+inline std::uint64_t parse_number(const char *arg)
+{
+    std::uint64_t value;
+    auto [end, error] = std::from_chars(arg, arg + std::strlen(arg), value);
+    if (error != std::errc{} || *end)
+        throw std::invalid_argument(std::string("Invalid number: ") + arg);
+    return value;
+}
+
+inline int parse_int(const char *arg)
+{
+    int value;
+    auto [end, error] = std::from_chars(arg, arg + std::strlen(arg), value);
+    if (error != std::errc{} || *end)
+        throw std::invalid_argument(std::string("Invalid number: ") + arg);
+    return value;
+}
+
+inline double parse_double(const char *arg)
+{
+    double value;
+    auto [end, error] = std::from_chars(arg, arg + std::strlen(arg), value);
+    if (error != std::errc{} || *end)
+        throw std::invalid_argument(std::string("Invalid number: ") + arg);
+    return value;
+}
+
+// Advances i to the value of the option at argv[i]
+inline const char *next_argument(int argc, const char **argv, int &i)
+{
+    if (++i == argc)
+        throw std::invalid_argument(std::string("Missing value for ") + argv[i - 1]);
+    return argv[i];
+}
+
+// Parses --uniform MIN MAX, --bernoulli M N or --weighted W0,W1,... at argv[i] into distribution,
+// a variant that holds any of them, and advances i past its values. Returns false for any other
+// option.
+template <typename Distribution> bool parse_distribution(int argc, const char **argv, int &i, Distribution &distribution)
+{
+    std::string arg = argv[i];
+    if (arg == "--uniform")
+    {
+        int min = parse_int(next_argument(argc, argv, i)), max = parse_int(next_argument(argc, argv, i));
+        if (min > max || std::uint64_t(std::int64_t(max) - min) >= max_outcomes)
+            throw std::invalid_argument("--uniform needs MIN <= MAX < MIN + 2^23");
+        distribution = uniform_distribution<int>{min, max};
+    }
+    else if (arg == "--bernoulli")
+    {
+        auto m = parse_number(next_argument(argc, argv, i)), n = parse_number(next_argument(argc, argv, i));
+        if (m == 0 || m >= n || n > max_outcomes)
+            throw std::invalid_argument("--bernoulli needs 0 < M < N <= 2^23");
+        distribution = bernoulli_distribution{m, n};
+    }
+    else if (arg == "--weighted")
+    {
+        std::vector<std::uint32_t> weights;
+        std::string list = next_argument(argc, argv, i);
+        std::uint64_t total = 0;
+        for (std::size_t start = 0; start <= list.size();)
+        {
+            auto end = std::min(list.find(',', start), list.size());
+            // Each weight is checked before it is narrowed, so that the total cannot wrap
+            auto weight = parse_number(list.substr(start, end - start).c_str());
+            if (weight > max_outcomes)
+                throw std::invalid_argument("--weighted needs weights that sum to between 1 and 2^23");
+            weights.push_back(std::uint32_t(weight));
+            total += weight;
+            start = end + 1;
+        }
+        if (total == 0 || total > max_outcomes)
+            throw std::invalid_argument("--weighted needs weights that sum to between 1 and 2^23");
+        distribution = weighted_distribution{weights};
+    }
+    else
+        return false;
+    return true;
+}
+} // namespace entropy_store::cli
@@ -0,0 +1,263 @@
+#include "aldr.hpp"
+#include "chacha.hpp"
+#include "cli_options.hpp"
+#include "entropy_metrics.hpp"
+#include "entropy_store.hpp"
+#include "fast_dice_roller.hpp"
+#include "fldr.hpp"
+#include "huber_vargas.hpp"
+#include "lemire.hpp"
+#include "mt19937.hpp"
+#include "philox.hpp"
+#include "statistical_tests.hpp"
+#include "von_neumann.hpp"
+#include "xoshiro128.hpp"
+#include "xoshiro256pp.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+// Runs the statistical test battery on the outputs of any generator in the repository, on
+// chunks of outputs in parallel, to qualify generators on very long runs.
+
+namespace
+{
+const char *usage = R"(Usage: entropy-battery [options]
+
+Generates values from a distribution and runs statistical tests on them, printing the
+statistic and p-value of each test. Exits with status 1 if any p-value is below the
+significance level.
+
+Generators:
+  --generator NAME         es32 (default), es64, fast-dice-roller, huber-vargas,
+                           von-neumann, lemire, fldr or aldr
+  --source NAME            xoshiro256pp (default), xoshiro128, philox4x32, chacha20,
+                           mt19937 or random_device
+
+Distributions:
+  --uniform MIN MAX        integers from MIN to MAX inclusive (default 1 6)
+  --bernoulli M N          1 with probability M/N, otherwise 0
+  --weighted W0,W1,...     i with probability proportional to Wi
+
+Options:
+  --samples K              number of values to test (default 10^8)
+  --tuple T                test non-overlapping T-tuples (default 2)
+  --threads T              threads testing chunks (default: all cores)
+  --alpha A                significance level (default 10^-6)
+  --help                   show this message
+)";
+
+using any_distribution = std::variant<entropy_store::uniform_distribution<int>, entropy_store::bernoulli_distribution,
+                                      entropy_store::weighted_distribution>;
+
+struct options
+{
+    any_distribution distribution = entropy_store::uniform_distribution<int>{1, 6};
+    std::string generator = "es32", source = "xoshiro256pp";
+    std::uint64_t samples = 100000000;
+    int tuple_size = 2;
+    unsigned threads = std::thread::hardware_concurrency();
+    double alpha = 1e-6;
+};
+
+int min_of(const entropy_store::uniform_distribution<int> &dist)
+{
+    return dist.min();
+}
+
+int min_of(const auto &)
+{
+    return 0;
+}
+
+int outcomes_of(const entropy_store::uniform_distribution<int> &dist)
+{
+    return dist.size();
+}
+
+int outcomes_of(const entropy_store::bernoulli_distribution &)
+{
+    return 2;
+}
+
+int outcomes_of(const entropy_store::weighted_distribution &dist)
+{
+    return dist.weights().size();
+}
+
+// FLDR and ALDR only generate weighted distributions
+entropy_store::weighted_distribution as_weighted(const entropy_store::uniform_distribution<int> &dist)
+{
+    return entropy_store::weighted_distribution(std::vector<std::uint32_t>(dist.size(), 1));
+}
+
+entropy_store::weighted_distribution as_weighted(const entropy_store::bernoulli_distribution &dist)
+{
+    return {std::uint32_t(dist.denominator() - dist.numerator()), std::uint32_t(dist.numerator())};
+}
+
+entropy_store::weighted_distribution as_weighted(const entropy_store::weighted_distribution &dist)
+{
+    return dist;
+}
+
+using fill_function = std::function<void(std::span<entropy_store::test_battery::value_type>)>;
+
+// Fills chunks with values from a generator, offset so that they start at 0
+fill_function filler(auto generator, auto dist)
+{
+    int min = min_of(dist);
+    return [=](std::span<entropy_store::test_battery::value_type> chunk) mutable {
+        for (auto &v : chunk)
+            v = generator(dist) - min;
+    };
+}
+
+fill_function make_filler(auto source, const std::string &generator, const auto &dist)
+{
+    auto bits = entropy_store::bit_generator{source};
+    if (generator == "es32")
+        return filler(entropy_store::entropy_store32{bits}, dist);
+    if (generator == "es64")
+        return filler(entropy_store::entropy_store64{bits}, dist);
+    if (generator == "fldr")
+        return filler(entropy_store::fldr_source{bits, as_weighted(dist)}, as_weighted(dist));
+    if (generator == "aldr")
+        return filler(entropy_store::aldr_source{bits, as_weighted(dist)}, as_weighted(dist));
+    if constexpr (std::is_same_v<std::decay_t<decltype(dist)>, entropy_store::uniform_distribution<int>>)
+    {
+        if (generator == "fast-dice-roller")
+            return filler(entropy_store::fast_dice_roller{bits}, dist);
+        if (generator == "huber-vargas")
+            return filler(entropy_store::huber_vargas{bits}, dist);
+        if (generator == "von-neumann")
+            return filler(entropy_store::von_neumann{bits}, dist);
+        if (generator == "lemire")
+            return filler(entropy_store::lemire{source}, dist);
+    }
+    else if (generator == "fast-dice-roller" || generator == "huber-vargas" || generator == "von-neumann" ||
+             generator == "lemire")
+        throw std::invalid_argument("--generator " + generator + " only generates --uniform");
+    throw std::invalid_argument("Unknown generator " + generator);
+}
+
+fill_function make_filler(const options &opts)
+{
+    entropy_store::random_device_generator rd;
+    return std::visit(
+        [&](const auto &dist) -> fill_function {
+            if (opts.source == "xoshiro256pp")
+                return make_filler(entropy_store::xoshiro256pp{rd}, opts.generator, dist);
+            if (opts.source == "xoshiro128")
+                return make_filler(entropy_store::xoshiro128{rd}, opts.generator, dist);
+            if (opts.source == "philox4x32")
+                return make_filler(entropy_store::philox4x32{rd}, opts.generator, dist);
+            if (opts.source == "chacha20")
+                return make_filler(entropy_store::chacha20{rd}, opts.generator, dist);
+            if (opts.source == "mt19937")
+                return make_filler(entropy_store::mt19937_source{}, opts.generator, dist);
+            if (opts.source == "random_device")
+                return make_filler(rd, opts.generator, dist);
+            throw std::invalid_argument("Unknown source " + opts.source);
+        },
+        opts.distribution);
+}
+
+int run(const options &opts)
+{
+    auto fill = make_filler(opts);
+    std::vector<double> probabilities = std::visit(
+        [](const auto &dist) {
+            std::vector<double> p(outcomes_of(dist));
+            for (int i = 0; i < int(p.size()); ++i)
+                p[i] = entropy_store::P(dist, i + min_of(dist));
+            return p;
+        },
+        opts.distribution);
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto battery = entropy_store::run_battery(fill, entropy_store::test_battery{probabilities, opts.tuple_size},
+                                              opts.samples, opts.threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    bool failed = false;
+    std::cout << "Test, Statistic, p-value\n";
+    for (auto &result : battery.results())
+    {
+        std::cout << result.name << ", " << result.statistic << ", " << result.p_value
+                  << (result.p_value < opts.alpha ? ", FAILED" : "") << "\n";
+        failed |= result.p_value < opts.alpha;
+    }
+    std::cerr << "Samples = " << battery.size() << "\n"
+              << "Time = " << seconds << " s\n"
+              << "Throughput = " << battery.size() / seconds / 1e6 << " M samples/s\n";
+    return failed;
+}
+
+using entropy_store::cli::parse_double;
+using entropy_store::cli::parse_int;
+using entropy_store::cli::parse_number;
+
+options parse_options(int argc, const char **argv)
+{
+    options opts;
+    auto next = [&](int &i) { return entropy_store::cli::next_argument(argc, argv, i); };
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (entropy_store::cli::parse_distribution(argc, argv, i, opts.distribution))
+            continue;
+        if (arg == "--generator")
+            opts.generator = next(i);
+        else if (arg == "--source")
+            opts.source = next(i);
+        else if (arg == "--samples")
+            opts.samples = parse_number(next(i));
+        else if (arg == "--tuple")
+        {
+            opts.tuple_size = parse_int(next(i));
+            if (opts.tuple_size < 1)
+                throw std::invalid_argument("--tuple needs T >= 1");
+        }
+        else if (arg == "--threads")
+            opts.threads = parse_number(next(i));
+        else if (arg == "--alpha")
+        {
+            opts.alpha = parse_double(next(i));
+            if (!(opts.alpha > 0 && opts.alpha < 1))
+                throw std::invalid_argument("--alpha needs 0 < A < 1");
+        }
+        else if (arg == "--help")
+        {
+            std::cout << usage;
+            std::exit(0);
+        }
+        else
+            throw std::invalid_argument("Unknown option " + arg);
+    }
+    return opts;
+}
+} // namespace
+
+int main(int argc, const char **argv)
+{
+    try
+    {
+        return run(parse_options(argc, argv));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << "entropy-battery: " << e.what() << "\n\n" << usage;
+        return 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "entropy-battery: " << e.what() << "\n";
+        return 1;
+    }
+}
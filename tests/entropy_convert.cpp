@@ -0,0 +1,355 @@
+#include "cli_options.hpp"
+#include "entropy_metrics.hpp"
+#include "entropy_store.hpp"
+#include "mmap_source.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// Converts raw entropy, for example a capture from a hardware RNG, into values from a distribution.
+// Files are memory-mapped; standard input is read in large blocks on a separate thread.
+
+namespace
+{
+const char *usage = R"(Usage: entropy-convert [options] [file]
+
+Reads raw entropy from file, or standard input if no file is given, and writes values
+from a distribution to standard output until the input runs out.
+
+Distributions:
+  --uniform MIN MAX        integers from MIN to MAX inclusive (default 0 1)
+  --bernoulli M N          1 with probability M/N, otherwise 0
+  --weighted W0,W1,...     i with probability proportional to Wi
+  --shuffle N              permutations of 0 to N-1
+
+Options:
+  --count K                stop after K values (or permutations)
+  --binary                 write each value as a 32-bit word in host byte order
+  --store64                use a 64-bit entropy store
+  --quiet                  do not report throughput and efficiency
+  --help                   show this message
+)";
+
+struct shuffle_distribution
+{
+    std::uint32_t n;
+};
+
+using any_distribution = std::variant<entropy_store::uniform_distribution<int>, entropy_store::bernoulli_distribution,
+                                      entropy_store::weighted_distribution, shuffle_distribution>;
+
+double entropy(const shuffle_distribution &dist)
+{
+    return std::lgamma(dist.n + 1.0) / std::log(2.0);
+}
+
+struct options
+{
+    any_distribution distribution = entropy_store::uniform_distribution<int>{0, 1};
+    std::uint64_t count = std::numeric_limits<std::uint64_t>::max();
+    bool binary = false, store64 = false, quiet = false;
+    const char *file = nullptr;
+};
+
+// Reads a stream in blocks on a background thread, so that reading the next block
+// overlaps with converting the current one. Throws entropy_exhausted at the end.
+// Unlike other sources, copies share the stream and take turns to read blocks from it.
+template <std::unsigned_integral T> class stream_entropy_source
+{
+  public:
+    using value_type = T;
+    using distribution_type = entropy_store::const_uniform_distribution<value_type, 0, std::numeric_limits<T>::max()>;
+
+    static constexpr std::size_t block_size = 1 << 20;
+
+    stream_entropy_source(std::FILE *file) : m_shared(std::make_shared<shared>())
+    {
+        m_shared->reader = std::thread([state = m_shared.get(), file] { state->read(file); });
+    }
+
+    distribution_type distribution() const
+    {
+        return {};
+    }
+
+    value_type operator()()
+    {
+        if (m_next == m_end) [[unlikely]]
+            next_block();
+        return *m_next++;
+    }
+
+    // The number of words handed out so far, including the current one
+    std::uint64_t consumed() const
+    {
+        return m_consumed - (m_end - m_next);
+    }
+
+  private:
+    void next_block()
+    {
+        auto words = m_shared->take(m_block);
+        if (words == 0)
+            throw entropy_store::entropy_exhausted(consumed());
+        m_next = m_block.data();
+        m_end = m_next + words;
+        m_consumed += words;
+    }
+
+    // Double buffering: the reader fills one block while the converter uses the other
+    struct shared
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<T> block = std::vector<T>(block_size);
+        std::size_t words = 0;
+        bool full = false, done = false, stopping = false;
+        std::thread reader;
+
+        void read(std::FILE *file)
+        {
+            std::vector<T> buffer(block_size);
+            for (;;)
+            {
+                auto bytes = std::fread(buffer.data(), 1, block_size * sizeof(T), file);
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&] { return !full || stopping; });
+                if (stopping)
+                    return;
+                std::swap(block, buffer);
+                words = bytes / sizeof(T); // A partial word at the end is ignored
+                full = true;
+                done = words == 0;
+                changed.notify_all();
+                if (done)
+                    return;
+            }
+        }
+
+        // Swaps the next block into `out` and returns its size, or 0 at the end of the stream
+        std::size_t take(std::vector<T> &out)
+        {
+            std::unique_lock lock(mutex);
+            changed.wait(lock, [&] { return full; });
+            if (done)
+                return 0;
+            out.resize(block_size);
+            std::swap(out, block);
+            full = false;
+            changed.notify_all();
+            return words;
+        }
+
+        // Waits for the current read to finish
+        ~shared()
+        {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            changed.notify_all();
+            reader.join();
+        }
+    };
+
+    std::shared_ptr<shared> m_shared;
+    std::vector<T> m_block;
+    const T *m_next = nullptr, *m_end = nullptr;
+    std::uint64_t m_consumed = 0;
+};
+
+template <std::unsigned_integral T> std::uint64_t consumed(const stream_entropy_source<T> &source)
+{
+    return source.consumed();
+}
+
+template <std::unsigned_integral T> std::uint64_t consumed(const entropy_store::mmap_entropy_source<T> &source)
+{
+    return source.size() - source.remaining().size();
+}
+
+// Buffers output and writes it in large blocks
+class output_buffer
+{
+  public:
+    output_buffer(bool binary) : m_binary(binary)
+    {
+        m_buffer.reserve(capacity + 32);
+    }
+
+    void write(std::int64_t value, char separator = '\n')
+    {
+        auto size = m_buffer.size();
+        if (m_binary)
+        {
+            auto word = std::uint32_t(value);
+            m_buffer.resize(size + sizeof(word));
+            std::memcpy(m_buffer.data() + size, &word, sizeof(word));
+        }
+        else
+        {
+            m_buffer.resize(size + 21);
+            auto end = std::to_chars(m_buffer.data() + size, m_buffer.data() + m_buffer.size() - 1, value).ptr;
+            *end++ = separator;
+            m_buffer.resize(end - m_buffer.data());
+        }
+        if (m_buffer.size() >= capacity)
+            flush();
+    }
+
+    void flush()
+    {
+        if (!m_buffer.empty() && std::fwrite(m_buffer.data(), 1, m_buffer.size(), stdout) != m_buffer.size())
+            throw std::runtime_error("Failed to write output");
+        m_buffer.clear();
+    }
+
+  private:
+    static constexpr std::size_t capacity = 1 << 20;
+    bool m_binary;
+    std::vector<char> m_buffer;
+};
+
+// Returns the number of values written
+template <std::integral Buffer, typename Source>
+std::uint64_t convert(entropy_store::entropy_store<Source, Buffer> &store, const options &opts, output_buffer &out)
+{
+    std::uint64_t written = 0;
+    try
+    {
+        std::visit(
+            [&](const auto &dist) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(dist)>, shuffle_distribution>)
+                {
+                    std::vector<std::uint32_t> cards(dist.n);
+                    for (; written < opts.count; ++written)
+                    {
+                        std::iota(cards.begin(), cards.end(), 0);
+                        entropy_store::shuffle(store, cards);
+                        for (std::size_t i = 0; i < cards.size(); ++i)
+                            out.write(cards[i], i + 1 == cards.size() ? '\n' : ' ');
+                    }
+                }
+                else
+                {
+                    for (; written < opts.count; ++written)
+                        out.write(store(dist));
+                }
+            },
+            opts.distribution);
+    }
+    catch (const entropy_store::entropy_exhausted &)
+    {
+        // The value being generated is incomplete and is dropped, and the store is not used again
+    }
+    return written;
+}
+
+template <std::integral Buffer, typename Source> int run(Source source, const options &opts)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    entropy_store::entropy_store<Source, Buffer> store{std::move(source)};
+    output_buffer out{opts.binary};
+    auto written = convert(store, opts, out);
+    out.flush();
+    auto end_time = std::chrono::steady_clock::now();
+
+    if (!opts.quiet)
+    {
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+        std::uint64_t input_bytes = sizeof(typename Source::value_type) * consumed(store.source());
+        double input_bits = 8.0 * input_bytes;
+        double output_bits = written * std::visit([](const auto &dist) { return entropy(dist); }, opts.distribution);
+        std::cerr << "Input bytes = " << input_bytes << "\n"
+                  << "Outputs = " << written << "\n"
+                  << "Time = " << seconds << " s\n"
+                  << "Input throughput = " << input_bytes / seconds / 1e6 << " MB/s\n"
+                  << "Output entropy = " << output_bits << " bits\n"
+                  << "Efficiency = " << (input_bits > 0 ? output_bits / input_bits : 0) << "\n";
+    }
+    return 0;
+}
+
+// Sources are read 8 bits at a time into a 32-bit store, and 16 bits at a time into a 64-bit store,
+// so that the store fetches as few times as possible while leaving plenty of room for resampling.
+template <std::integral Buffer> int run(const options &opts)
+{
+    using word = std::conditional_t<sizeof(Buffer) == 8, std::uint16_t, std::uint8_t>;
+    if (opts.file)
+        return run<Buffer>(entropy_store::mmap_entropy_source<word>{opts.file}, opts);
+    return run<Buffer>(stream_entropy_source<word>{stdin}, opts);
+}
+
+using entropy_store::cli::parse_int;
+using entropy_store::cli::parse_number;
+
+options parse_options(int argc, const char **argv)
+{
+    options opts;
+    auto next = [&](int &i) { return entropy_store::cli::next_argument(argc, argv, i); };
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (entropy_store::cli::parse_distribution(argc, argv, i, opts.distribution))
+            continue;
+        if (arg == "--shuffle")
+        {
+            auto n = parse_number(next(i));
+            if (n == 0 || n > entropy_store::cli::max_outcomes)
+                throw std::invalid_argument("--shuffle needs 0 < N <= 2^23");
+            opts.distribution = shuffle_distribution{std::uint32_t(n)};
+        }
+        else if (arg == "--count")
+            opts.count = parse_number(next(i));
+        else if (arg == "--binary")
+            opts.binary = true;
+        else if (arg == "--store64")
+            opts.store64 = true;
+        else if (arg == "--quiet")
+            opts.quiet = true;
+        else if (arg == "--help")
+        {
+            std::cout << usage;
+            std::exit(0);
+        }
+        else if (arg.starts_with("-") && arg != "-")
+            throw std::invalid_argument("Unknown option " + arg);
+        else if (opts.file)
+            throw std::invalid_argument("Only one input file can be given");
+        else if (arg != "-")
+            opts.file = argv[i];
+    }
+    return opts;
+}
+} // namespace
+
+int main(int argc, const char **argv)
+{
+    try
+    {
+        auto opts = parse_options(argc, argv);
+        return opts.store64 ? run<std::uint64_t>(opts) : run<std::uint32_t>(opts);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << "entropy-convert: " << e.what() << "\n\n" << usage;
+        return 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "entropy-convert: " << e.what() << "\n";
+        return 1;
+    }
+}
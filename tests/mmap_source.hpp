@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace entropy_store
+{
+// Thrown when a source has handed out every value it has, for example the end of a recorded capture.
+class entropy_exhausted : public std::runtime_error
+{
+  public:
+    entropy_exhausted(std::uint64_t consumed)
+        : std::runtime_error("Entropy exhausted after " + std::to_string(consumed) + " values"), m_consumed(consumed)
+    {
+    }
+
+    std::uint64_t consumed() const
+    {
+        return m_consumed;
+    }
+
+  private:
+    std::uint64_t m_consumed;
+};
+
+// Replays a file of recorded random words, for example a capture from a hardware RNG, by mapping it
+// read-only rather than loading it into memory. Words are in host byte order, and a partial word at
+// the end of the file is ignored.
+//
+// Copies share the mapping but keep their own position, so a copy replays the capture from where the
+// original was when it was copied. Reading past the end throws entropy_exhausted; use remaining() to
+// stop before then, or to read the unread words in place.
+//
+// The exception is thrown from inside the fetch of whichever store uses the source, part way
+// through generating an output. That output is lost, and the store may have consumed or changed
+// part of its entropy (U_s, s) without finishing, so the store must be discarded afterwards.
+// To keep using a store, stop while remaining() still holds a margin of words, since an output
+// needs an unbounded, though usually small, number of them.
+template <std::unsigned_integral T = std::uint32_t> class mmap_entropy_source
+{
+  public:
+    using value_type = T;
+    using distribution_type = const_uniform_distribution<value_type, std::numeric_limits<value_type>::min(),
+                                                         std::numeric_limits<value_type>::max()>;
+
+    mmap_entropy_source(const std::string &path) : m_file(std::make_shared<const mapping>(path.c_str()))
+    {
+        m_next = m_file->begin();
+        m_end = m_next + m_file->size() / sizeof(value_type);
+    }
+
+    constexpr distribution_type distribution() const
+    {
+        return {};
+    }
+
+    constexpr value_type min() const
+    {
+        return 0;
+    }
+    constexpr value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+    value_type operator()()
+    {
+        if (m_next == m_end)
+            throw entropy_exhausted(size());
+        return *m_next++;
+    }
+
+    // The words that have not been read yet
+    std::span<const value_type> remaining() const
+    {
+        return {m_next, m_end};
+    }
+
+    // Skips words, for example after reading them through remaining()
+    void discard(std::size_t count)
+    {
+        if (count > std::size_t(m_end - m_next))
+            throw entropy_exhausted(size());
+        m_next += count;
+    }
+
+    bool exhausted() const
+    {
+        return m_next == m_end;
+    }
+
+    // The number of words in the file
+    std::size_t size() const
+    {
+        return m_file->size() / sizeof(value_type);
+    }
+
+    int bits() const
+    {
+        return 8 * sizeof(value_type);
+    }
+
+  private:
+    class mapping
+    {
+      public:
+        mapping(const char *path)
+        {
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), path);
+            struct stat info;
+            if (::fstat(fd, &info) != 0)
+            {
+                int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), path);
+            }
+            m_size = info.st_size;
+            if (m_size > 0)
+            {
+                m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (m_data == MAP_FAILED)
+                {
+                    int error = errno;
+                    ::close(fd);
+                    throw std::system_error(error, std::generic_category(), path);
+                }
+                // Hints only, so failures are ignored
+                ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+                ::madvise(m_data, m_size, MADV_HUGEPAGE);
+#endif
+            }
+            // The mapping keeps the file alive
+            ::close(fd);
+        }
+
+        ~mapping()
+        {
+            if (m_size > 0)
+                ::munmap(m_data, m_size);
+        }
+
+        mapping(const mapping &) = delete;
+        mapping &operator=(const mapping &) = delete;
+
+        const value_type *begin() const
+        {
+            return static_cast<const value_type *>(m_data);
+        }
+
+        std::size_t size() const
+        {
+            return m_size;
+        }
+
+      private:
+        void *m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+
+    std::shared_ptr<const mapping> m_file;
+    const value_type *m_next, *m_end;
+};
+
+template <std::unsigned_integral T> double internal_entropy(const mmap_entropy_source<T> &)
+{
+    return 0;
+}
+
+} // namespace entropy_store
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace entropy_store
+{
+// Counts a hardware event on the calling thread using perf_event_open.
+// Counters are often unavailable (non-Linux, virtual machines, perf_event_paranoid),
+// in which case valid() is false and the counter reads as zero.
+class perf_counter
+{
+  public:
+#ifdef __linux__
+    perf_counter(std::uint32_t type, std::uint64_t config)
+    {
+        perf_event_attr attr{};
+        attr.type = type;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // The kernel multiplexes counters when there are more events than hardware counters
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        m_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~perf_counter()
+    {
+        if (valid())
+            close(m_fd);
+    }
+
+    void start()
+    {
+        if (valid())
+        {
+            // Resetting clears the count but not the times, so keep them to scale by this run alone
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            std::uint64_t values[3] = {};
+            if (read_values(values))
+            {
+                m_enabled = values[1];
+                m_running = values[2];
+            }
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop()
+    {
+        if (valid())
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    // The count since start(), scaled up for any time since then that the counter was multiplexed out
+    std::uint64_t read() const
+    {
+        std::uint64_t values[3] = {};
+        if (!read_values(values))
+            return 0;
+        auto enabled = values[1] - m_enabled, running = values[2] - m_running;
+        if (running == 0)
+            return 0;
+        return running < enabled ? std::uint64_t(double(values[0]) * enabled / running) : values[0];
+    }
+#else
+    perf_counter(std::uint32_t, std::uint64_t)
+    {
+    }
+
+    void start()
+    {
+    }
+
+    void stop()
+    {
+    }
+
+    std::uint64_t read() const
+    {
+        return 0;
+    }
+#endif
+
+    perf_counter(const perf_counter &) = delete;
+    perf_counter &operator=(const perf_counter &) = delete;
+
+    perf_counter(perf_counter &&other) noexcept
+        : m_fd(std::exchange(other.m_fd, -1)), m_enabled(other.m_enabled), m_running(other.m_running)
+    {
+    }
+
+    bool valid() const
+    {
+        return m_fd >= 0;
+    }
+
+  private:
+#ifdef __linux__
+    // The value, time enabled and time running
+    bool read_values(std::uint64_t (&values)[3]) const
+    {
+        return valid() && ::read(m_fd, values, sizeof(values)) == sizeof(values);
+    }
+#endif
+
+    int m_fd = -1;
+    // The times when the counter was last started
+    std::uint64_t m_enabled = 0, m_running = 0;
+};
+
+#ifdef __linux__
+inline perf_counter cache_miss_counter()
+{
+    return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+}
+
+inline perf_counter cycle_counter()
+{
+    return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+}
+
+inline perf_counter instruction_counter()
+{
+    return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+}
+
+inline perf_counter branch_miss_counter()
+{
+    return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+}
+
+inline perf_counter l1d_miss_counter()
+{
+    return {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+}
+
+inline perf_counter llc_miss_counter()
+{
+    return {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+}
+#else
+inline perf_counter cache_miss_counter()
+{
+    return {0, 0};
+}
+
+inline perf_counter cycle_counter()
+{
+    return {0, 0};
+}
+
+inline perf_counter instruction_counter()
+{
+    return {0, 0};
+}
+
+inline perf_counter branch_miss_counter()
+{
+    return {0, 0};
+}
+
+inline perf_counter l1d_miss_counter()
+{
+    return {0, 0};
+}
+
+inline perf_counter llc_miss_counter()
+{
+    return {0, 0};
+}
+#endif
+
+} // namespace entropy_store
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+namespace entropy_store
+{
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// Each output block is a pure function of the key and a 128-bit counter. The low 64 bits of the
+// counter are the block index and the high 64 bits are the stream id, so seek() gives random
+// access within a stream, and split() gives independent streams that never overlap.
+// Blocks are generated `lanes` at a time in a layout that compilers can vectorize.
+class philox4x32
+{
+  public:
+    using value_type = std::uint32_t;
+    using distribution_type = const_uniform_distribution<value_type, std::numeric_limits<value_type>::min(),
+                                                         std::numeric_limits<value_type>::max()>;
+
+    static constexpr std::size_t lanes = 8;
+    static constexpr std::size_t words_per_block = 4;
+
+    explicit philox4x32(std::uint64_t key = 0, std::uint64_t stream = 0)
+        : m_key{std::uint32_t(key), std::uint32_t(key >> 32)}, m_stream(stream)
+    {
+        refill();
+    }
+
+    template <entropy_generator Seed>
+        requires(!std::is_same_v<Seed, philox4x32>)
+    philox4x32(Seed &seed) : m_key{seed(), seed()}
+    {
+        refill();
+    }
+
+    constexpr distribution_type distribution() const
+    {
+        return {};
+    }
+
+    constexpr value_type min() const
+    {
+        return 0;
+    }
+    constexpr value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+    value_type operator()()
+    {
+        if (m_index == m_buffer.size())
+        {
+            m_block += lanes;
+            refill();
+            m_index = 0;
+        }
+        return m_buffer[m_index++];
+    }
+
+    void fill(std::span<value_type> words)
+    {
+        for (auto out = words.begin(); out != words.end();)
+        {
+            if (m_index == m_buffer.size())
+            {
+                m_block += lanes;
+                refill();
+                m_index = 0;
+            }
+            auto n = std::min<std::size_t>(m_buffer.size() - m_index, words.end() - out);
+            out = std::copy_n(m_buffer.begin() + m_index, n, out);
+            m_index += n;
+        }
+    }
+
+    int bits() const
+    {
+        return 32;
+    }
+
+    // Moves to the given output word in the current stream
+    void seek(std::uint64_t offset)
+    {
+        m_block = offset / m_buffer.size() * lanes;
+        refill();
+        m_index = offset % m_buffer.size();
+    }
+
+    // The number of words output so far in the current stream
+    std::uint64_t tell() const
+    {
+        return m_block * words_per_block + m_index;
+    }
+
+    // A generator with the same key, positioned at the start of another stream
+    philox4x32 split(std::uint64_t stream) const
+    {
+        auto result = *this;
+        result.m_stream = stream;
+        result.seek(0);
+        return result;
+    }
+
+    std::uint64_t stream() const
+    {
+        return m_stream;
+    }
+
+    // A single block, for testing against known answers
+    static std::array<std::uint32_t, 4> block(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+    {
+        for (int round = 0; round < 10; ++round)
+        {
+            std::uint64_t p0 = std::uint64_t(multiplier0) * counter[0];
+            std::uint64_t p1 = std::uint64_t(multiplier1) * counter[2];
+            counter = {std::uint32_t(p1 >> 32) ^ counter[1] ^ key[0], std::uint32_t(p1),
+                       std::uint32_t(p0 >> 32) ^ counter[3] ^ key[1], std::uint32_t(p0)};
+            key[0] += weyl0;
+            key[1] += weyl1;
+        }
+        return counter;
+    }
+
+  private:
+    static constexpr std::uint32_t multiplier0 = 0xD2511F53, multiplier1 = 0xCD9E8D57;
+    static constexpr std::uint32_t weyl0 = 0x9E3779B9, weyl1 = 0xBB67AE85;
+
+    void refill()
+    {
+        // One array per counter word, with one element per lane
+        std::uint32_t c0[lanes], c1[lanes], c2[lanes], c3[lanes];
+        for (std::size_t i = 0; i < lanes; ++i)
+        {
+            std::uint64_t block = m_block + i;
+            c0[i] = std::uint32_t(block);
+            c1[i] = std::uint32_t(block >> 32);
+            c2[i] = std::uint32_t(m_stream);
+            c3[i] = std::uint32_t(m_stream >> 32);
+        }
+
+        std::uint32_t k0 = m_key[0], k1 = m_key[1];
+        for (int round = 0; round < 10; ++round)
+        {
+            for (std::size_t i = 0; i < lanes; ++i)
+            {
+                std::uint64_t p0 = std::uint64_t(multiplier0) * c0[i];
+                std::uint64_t p1 = std::uint64_t(multiplier1) * c2[i];
+                c0[i] = std::uint32_t(p1 >> 32) ^ c1[i] ^ k0;
+                c1[i] = std::uint32_t(p1);
+                c2[i] = std::uint32_t(p0 >> 32) ^ c3[i] ^ k1;
+                c3[i] = std::uint32_t(p0);
+            }
+            k0 += weyl0;
+            k1 += weyl1;
+        }
+
+        for (std::size_t i = 0; i < lanes; ++i)
+        {
+            m_buffer[i * words_per_block] = c0[i];
+            m_buffer[i * words_per_block + 1] = c1[i];
+            m_buffer[i * words_per_block + 2] = c2[i];
+            m_buffer[i * words_per_block + 3] = c3[i];
+        }
+    }
+
+    std::array<std::uint32_t, 2> m_key;
+    std::uint64_t m_stream = 0, m_block = 0;
+    std::array<std::uint32_t, lanes * words_per_block> m_buffer;
+    std::size_t m_index = 0;
+};
+
+inline double internal_entropy(const philox4x32 &)
+{
+    return 0;
+}
+
+} // namespace entropy_store
@@ -1,16 +1,31 @@
 #include "aldr.hpp"
 #include "c_code.hpp"
+#include "chacha.hpp"
+#include "entropy_analysis.hpp"
+#include "entropy_distributions.hpp"
 #include "entropy_metrics.hpp"
 #include "entropy_store.hpp"
+#include "entropy_telemetry.hpp"
 #include "fldr.hpp"
 #include "huber_vargas.hpp"
 #include "von_neumann.hpp"
 #include "fast_dice_roller.hpp"
 #include "lemire.hpp"
+#include "mixed_radix.hpp"
+#include "mmap_source.hpp"
+#include "philox.hpp"
+#include "statistical_tests.hpp"
 #include "xoshiro128.hpp"
+#include "xoshiro128x8.hpp"
+#include "xoshiro256pp.hpp"
 
 #include "testing.hpp"
 
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
 using namespace entropy_store;
 
 template <entropy_generator Source> void count_totals(Source src, int count, double min = 0.99, double max = 1.01)
@@ -26,6 +41,231 @@ template <entropy_generator Source> void count_totals(Source src, int count, dou
     assert(efficiency <= max);
 }
 
+// The weight of each outcome of a component of a product_distribution
+template <std::integral T> std::vector<std::uint32_t> weights_of(const uniform_distribution<T> &dist)
+{
+    return std::vector<std::uint32_t>(dist.size(), 1);
+}
+
+template <std::integral T, T Min, T Max>
+std::vector<std::uint32_t> weights_of(const const_uniform_distribution<T, Min, Max> &dist)
+{
+    return weights_of(uniform_distribution<T>{dist});
+}
+
+inline std::vector<std::uint32_t> weights_of(const bernoulli_distribution &dist)
+{
+    return {std::uint32_t(dist.denominator() - dist.numerator()), std::uint32_t(dist.numerator())};
+}
+
+template <std::integral T, T M, T N> std::vector<std::uint32_t> weights_of(const const_bernoulli_distribution<T, M, N> &dist)
+{
+    return weights_of(bernoulli_distribution{dist});
+}
+
+inline std::vector<std::uint32_t> weights_of(const weighted_distribution &dist)
+{
+    return {dist.weights().begin(), dist.weights().end()};
+}
+
+// Numbers the outputs of a product_distribution, so that they can be
+// checked against a single weighted distribution
+template <typename Source, distribution... Ds> class numbered_product
+{
+  public:
+    using source_type = Source;
+    using distribution_type = weighted_distribution;
+    using value_type = distribution_type::value_type;
+
+    numbered_product(Source source, const product_distribution<Ds...> &dist)
+        : m_source(std::move(source)), m_product(dist), m_distribution(product_weights(dist))
+    {
+    }
+
+    value_type operator()()
+    {
+        return std::apply(
+            [&](auto... values) {
+                return std::apply(
+                    [&](const auto &...dists) {
+                        value_type index = 0;
+                        ((index = index * (dists.max() - dists.min() + 1) + (values - dists.min())), ...);
+                        return index;
+                    },
+                    m_product.components());
+            },
+            m_source(m_product));
+    }
+
+    const distribution_type &distribution() const
+    {
+        return m_distribution;
+    }
+
+    const source_type &source() const
+    {
+        return m_source;
+    }
+
+  private:
+    static std::vector<std::uint32_t> product_weights(const product_distribution<Ds...> &dist)
+    {
+        std::vector<std::uint32_t> weights{1};
+        std::apply(
+            [&](const auto &...dists) {
+                auto multiply = [&](const std::vector<std::uint32_t> &w) {
+                    std::vector<std::uint32_t> result;
+                    for (auto a : weights)
+                        for (auto b : w)
+                            result.push_back(a * b);
+                    weights = result;
+                };
+                (multiply(weights_of(dists)), ...);
+            },
+            dist.components());
+        return weights;
+    }
+
+    Source m_source;
+    product_distribution<Ds...> m_product;
+    distribution_type m_distribution;
+};
+
+template <typename Source, distribution... Ds> auto bits_fetched(const numbered_product<Source, Ds...> &g)
+{
+    return bits_fetched(g.source());
+}
+
+template <typename Source, distribution... Ds> auto internal_entropy(const numbered_product<Source, Ds...> &g)
+{
+    return internal_entropy(g.source());
+}
+
+// Caps the outputs of a geometric_distribution, so that they can be
+// checked against a weighted distribution with exact weights
+template <typename Source> class capped_geometric
+{
+  public:
+    using source_type = Source;
+    using distribution_type = weighted_distribution;
+    using value_type = distribution_type::value_type;
+
+    capped_geometric(Source source, const geometric_distribution &dist, value_type cap)
+        : m_source(std::move(source)), m_geometric(dist), m_cap(cap), m_distribution(capped_weights(dist, cap))
+    {
+    }
+
+    value_type operator()()
+    {
+        return std::min<std::uint64_t>(m_source(m_geometric), m_cap);
+    }
+
+    const distribution_type &distribution() const
+    {
+        return m_distribution;
+    }
+
+    const source_type &source() const
+    {
+        return m_source;
+    }
+
+  private:
+    // P(i) = q^i p for i < cap, and P(cap) = q^cap, scaled by d^cap
+    static std::vector<std::uint32_t> capped_weights(const geometric_distribution &dist, value_type cap)
+    {
+        std::uint64_t m = dist.numerator(), d = dist.denominator();
+        std::vector<std::uint32_t> weights;
+        std::uint64_t q_i = 1, d_i = 1;
+        for (value_type i = 0; i < cap; ++i)
+            d_i *= d;
+        for (value_type i = 0; i < cap; ++i)
+        {
+            d_i /= d;
+            weights.push_back(q_i * m * d_i);
+            q_i *= d - m;
+        }
+        weights.push_back(q_i);
+        return weights;
+    }
+
+    Source m_source;
+    geometric_distribution m_geometric;
+    value_type m_cap;
+    distribution_type m_distribution;
+};
+
+template <typename Source> auto bits_fetched(const capped_geometric<Source> &g)
+{
+    return bits_fetched(g.source());
+}
+
+template <typename Source> auto internal_entropy(const capped_geometric<Source> &g)
+{
+    return internal_entropy(g.source());
+}
+
+// Exact base 2^16 digits of (1 - numerator/denominator)^(2^i), by long division of big integers
+// stored as base 2^32 limbs, least significant first
+std::vector<std::uint32_t> exact_power_digits(std::uint64_t numerator, std::uint64_t denominator, std::size_t i,
+                                              std::size_t digits)
+{
+    using big = std::vector<std::uint32_t>;
+    auto multiply = [](const big &a, const big &b) {
+        big result(a.size() + b.size(), 0);
+        for (std::size_t x = 0; x < a.size(); ++x)
+        {
+            std::uint64_t carry = 0;
+            for (std::size_t y = 0; y < b.size(); ++y)
+            {
+                carry += result[x + y] + std::uint64_t(a[x]) * b[y];
+                result[x + y] = std::uint32_t(carry);
+                carry >>= 32;
+            }
+            result[x + b.size()] = std::uint32_t(carry);
+        }
+        return result;
+    };
+    auto power = [&](std::uint64_t x) {
+        big result{std::uint32_t(x), std::uint32_t(x >> 32)};
+        for (std::size_t k = 0; k < i; ++k)
+            result = multiply(result, result);
+        return result;
+    };
+    big remainder = power(denominator - numerator), divisor = power(denominator);
+    remainder.push_back(0);
+    divisor.resize(remainder.size(), 0);
+    auto less = [](const big &a, const big &b) {
+        return std::lexicographical_compare(a.rbegin(), a.rend(), b.rbegin(), b.rend());
+    };
+
+    std::vector<std::uint32_t> result;
+    for (std::size_t j = 0; j < digits; ++j)
+    {
+        std::uint32_t digit = 0;
+        for (int bit = 0; bit < 16; ++bit)
+        {
+            // remainder = 2 * remainder, then subtract the divisor if it fits
+            for (auto k = remainder.size(); k-- > 0;)
+                remainder[k] = (remainder[k] << 1) | (k > 0 ? remainder[k - 1] >> 31 : 0);
+            digit <<= 1;
+            if (!less(remainder, divisor))
+            {
+                std::uint64_t borrow = 0;
+                for (std::size_t k = 0; k < remainder.size(); ++k)
+                {
+                    auto d = std::uint64_t(remainder[k]) - divisor[k] - borrow;
+                    remainder[k] = std::uint32_t(d);
+                    borrow = d >> 63;
+                }
+                digit |= 1;
+            }
+        }
+        result.push_back(digit);
+    }
+    return result;
+}
+
 int main(int argc, char **argv)
 {
     int N = 1000;
@@ -60,6 +300,665 @@ int main(int argc, char **argv)
     count_totals(entropy_converter{bits, weighted_distribution{4, 1, 5}}, N, 0.96, 1.05);
     count_totals(entropy_converter64{bits, weighted_distribution{4, 1, 5}}, N, 0.96, 1.05);
 
+    // Shared and non-owning weighted tables
+    const weighted_distribution table{1, 2, 3, 4};
+    static_assert(!std::is_constructible_v<weighted_view, weighted_distribution>);
+    static_assert(!std::is_constructible_v<weighted_view, shared_weighted_distribution>);
+    static_assert(std::is_constructible_v<weighted_view, const shared_weighted_distribution &>);
+    count_totals(entropy_converter{bits, weighted_view{table}}, N, 0.97, 1.03);
+    count_totals(entropy_converter{bits, shared_weighted_distribution{table}}, N, 0.97, 1.03);
+
+    // Rows of a table set
+    weighted_table_set table_set;
+    table_set.add({3, 1});
+    table_set.add({1, 2, 3, 4});
+    table_set.add({5});
+    count_totals(entropy_converter{bits, table_set[1]}, N, 0.97, 1.03);
+    auto es = entropy_store32{bits};
+    for (int i = 0; i < N; ++i)
+    {
+        assert(es(table_set, 0) < 2);
+        assert(es(table_set, 2) == 0);
+    }
+
+    // Product distributions
+    count_totals(numbered_product{entropy_store32{bits}, product_distribution{const_uniform<1, 6>{}, const_uniform<0, 1>{}}},
+                 N);
+    count_totals(
+        numbered_product{entropy_store32{bits}, product_distribution{uniform_distribution{1, 6}, bernoulli_distribution{1, 3},
+                                                                     weighted_distribution{1, 2, 3}}},
+        N, 0.97, 1.03);
+    count_totals(numbered_product{entropy_store64{bits}, product_distribution{const_uniform<1, 6>{}, const_bernoulli<1, 3>{}}},
+                 N, 0.97, 1.03);
+    {
+        auto es = entropy_store32{bits};
+        uniform_tuple<int> dice{{1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6}, {1, 6}, {0, 99}};
+        std::vector<int> roll(dice.size());
+        for (int i = 0; i < N; ++i)
+        {
+            es(dice, std::span{roll});
+            for (int j = 0; j < roll.size(); ++j)
+                assert(roll[j] >= dice.components()[j].min() && roll[j] <= dice.components()[j].max());
+        }
+    }
+
+    // Sums of dice
+    count_totals(entropy_converter{bits, dice_sum_distribution{3, 6, 2}}, N, 0.97, 1.03);
+    {
+        // Too many totals for the pair counts to be checked, so check the efficiency and the means.
+        // 10d6 fits in one draw from a 32-bit store, and 10d10 in one draw from a 64-bit store.
+        auto check_sum = [&](auto converter, double mean, double sd, double min) {
+            auto check = check_distribution{std::move(converter)};
+            check.read(10 * N);
+            double total = 0;
+            check.visit_counts([&](auto value, auto count, auto...) { total += double(count) * value; });
+            assert(std::abs(total / (10 * N) - mean) < 5 * sd / std::sqrt(10 * N));
+            assert(check.efficiency() >= min && check.efficiency() <= 1.03);
+        };
+        check_sum(entropy_converter64{bits, dice_sum_distribution{10, 6}}, 35, 5.4, 0.97);
+        check_sum(entropy_converter64{bits, dice_sum_distribution{10, 10}}, 55, 9.1, 0.97);
+        // Rejection sampling 6^10 values from at least 2^30 loses about 3% of the 4.5 bits of 10d6
+        check_sum(entropy_converter{bits, dice_sum_distribution{10, 6}}, 35, 5.4, 0.94);
+        // Split into parts in a 32-bit store
+        check_sum(entropy_converter{bits, dice_sum_distribution{10, 10}}, 55, 9.1, 0.5);
+    }
+
+    // Geometric distributions and sparse selection
+    for (auto [numerator, denominator] : {std::pair{1, 240}, {43, 345}, {1, 3}, {2, 5}, {1, 1000}, {12345, 1 << 20}})
+    {
+        geometric_distribution dist(numerator, denominator);
+        for (std::size_t i = 0; i <= dist.levels(); ++i)
+        {
+            auto exact = exact_power_digits(numerator, denominator, i, 8);
+            for (std::size_t j = 0; j < exact.size(); ++j)
+                assert(dist.digit(i, j) == exact[j]);
+        }
+    }
+    assert(geometric_distribution(1, 240).digit(6, 2) == 2212 && geometric_distribution(43, 345).digit(3, 2) == 14338);
+    count_totals(capped_geometric{entropy_store32{bits}, geometric_distribution{1, 2}, 8}, N, 0.6, 1.2);
+    count_totals(capped_geometric{entropy_store32{bits}, geometric_distribution{1, 3}, 8}, N, 0.6, 1.2);
+    count_totals(capped_geometric{entropy_store64{bits}, geometric_distribution{2, 5}, 8}, N, 0.6, 1.2);
+    {
+        // Mean of 999 failures per success, and 3 x 99 failures before 3 successes
+        auto es = entropy_store32{bits};
+        double geometric_total = 0, negative_binomial_total = 0;
+        for (int i = 0; i < N; ++i)
+        {
+            geometric_total += es(geometric_distribution{1, 1000});
+            negative_binomial_total += es(negative_binomial_distribution{3, 1, 100});
+        }
+        assert(std::abs(geometric_total / N - 999) < 5 * 999 / std::sqrt(N));
+        assert(std::abs(negative_binomial_total / N - 297) < 5 * 173 / std::sqrt(N));
+
+        std::vector<std::uint64_t> selected;
+        bernoulli_select(es, 1000 * N, bernoulli_distribution{1, 100}, std::back_inserter(selected));
+        assert(std::is_sorted(selected.begin(), selected.end()));
+        assert(selected.empty() || selected.back() < 1000 * N);
+        assert(std::abs(double(selected.size()) - 10 * N) < 5 * std::sqrt(10 * N));
+    }
+
+    {
+        // Each of 20 records should be in a sample of 5 with probability 1/4
+        auto es = entropy_store32{bits};
+        std::vector<int> kept(20);
+        for (int i = 0; i < N; ++i)
+        {
+            reservoir_sampler<int> sampler(5);
+            for (int r = 0; r < 20; ++r)
+            {
+                if (r >= 5 && sampler.skip() > 0 && r % 2)
+                    sampler.discard(1);
+                else
+                    sampler.push(es, r);
+            }
+            assert(sampler.count() == 20);
+            assert(sampler.samples().size() == 5);
+            for (auto r : sampler.samples())
+                ++kept[r];
+        }
+        for (auto c : kept)
+            assert(std::abs(c - N / 4.0) < 5 * std::sqrt(N * 3 / 16.0));
+    }
+
+    {
+        // With k = 1, the candidate skips are heavy-tailed and often exceed a 32-bit store's range
+        auto es = entropy_store32{bits};
+        std::vector<int> kept(10);
+        for (int i = 0; i < 10 * N; ++i)
+        {
+            reservoir_sampler<int> sampler(1);
+            for (int r = 0; r < 1000; ++r)
+                sampler.push(es, r / 100);
+            ++kept[sampler.samples()[0]];
+        }
+        for (auto c : kept)
+            assert(std::abs(c - N) < 5 * std::sqrt(N * 0.9));
+
+        int ones = 0;
+        for (int i = 0; i < N; ++i)
+            ones += es(large_bernoulli_distribution{std::uint64_t(1) << 40, 3 * (std::uint64_t(1) << 40) + 1});
+        assert(std::abs(ones - N / 3.0) < 5 * std::sqrt(N * 2 / 9.0));
+    }
+
+    // Zipf distributions, where each attempt draws whole bytes and the rest of the uniform is unused
+    count_totals(entropy_converter{bits, zipf_distribution{6, 1}}, N, 0.2, 0.4);
+    count_totals(entropy_converter64{bits, zipf_distribution{6, 0.5}}, N, 0.2, 0.4);
+    count_totals(entropy_converter{bits, zipf_distribution{6, 2.5}}, N, 0.08, 0.25);
+    {
+        auto es = entropy_store64{bits};
+        for (int i = 0; i < N; ++i)
+        {
+            auto k = es(zipf_distribution{1000000000, 1.1});
+            assert(k >= 1 && k <= 1000000000);
+        }
+    }
+
+    // Discrete Gaussians
+    {
+        auto es = entropy_store32{bits};
+        const discrete_gaussian_distribution gaussian{3};
+        std::vector<int> counts(25);
+        for (int i = 0; i < N; ++i)
+            ++counts[std::clamp<std::int64_t>(es(gaussian), -12, 12) + 12];
+        for (int i = 1; i + 1 < counts.size(); ++i)
+        {
+            auto p = P(gaussian, i - 12);
+            assert(std::abs(counts[i] - N * p) < 5 * std::sqrt(N * p * (1 - p)) + 1);
+        }
+
+        // Mean and variance for rational centers and the CDT sampler
+        auto check_moments = [&](const auto &dist, double mean, double sigma) {
+            auto es = entropy_store64{bits};
+            std::vector<std::int64_t> samples(N);
+            es(dist, std::span{samples});
+            double total = 0, total2 = 0;
+            for (auto y : samples)
+            {
+                total += y;
+                total2 += (y - mean) * (y - mean);
+            }
+            assert(std::abs(total / N - mean) < 5 * sigma / std::sqrt(N));
+            assert(std::abs(total2 / N / (sigma * sigma) - 1) < 5 * std::sqrt(2.0 / N));
+        };
+        check_moments(discrete_gaussian_distribution{3}, 0, 3);
+        check_moments(discrete_gaussian_distribution{2, 7, 2}, 3.5, 2);
+        check_moments(discrete_gaussian_distribution{20, -5, 3}, -5 / 3.0, 20);
+        check_moments(discrete_gaussian_distribution{1000, 1, 7}, 1 / 7.0, 1000);
+        check_moments(cdt_gaussian_distribution{20, -4}, -4, 20);
+    }
+
+    // Counter-based sources, checked against the Random123 and RFC 8439 test vectors
+    assert((philox4x32::block({0, 0, 0, 0}, {0, 0}) ==
+            std::array<std::uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    assert((philox4x32::block({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}) ==
+            std::array<std::uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+    assert((philox4x32::block({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}) ==
+            std::array<std::uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+    {
+        philox4x32 philox{0x299f31d0a4093822, 0x0370734413198a2e};
+        philox.seek(4 * 0x12345678abcd + 1);
+        auto block = philox4x32::block({0x5678abcd, 0x1234, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0});
+        assert(philox() == block[1] && philox() == block[2] && philox() == block[3]);
+
+        chacha20 chacha{{0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c, 0x13121110, 0x17161514, 0x1b1a1918,
+                         0x1f1e1d1c},
+                        0x4a000000};
+        chacha.seek(std::uint64_t(16) * 0x0900000000000001);
+        assert(chacha() == 0xe4e7f110 && chacha() == 0x15593bd1 && chacha() == 0x1fdd0f50 && chacha() == 0xc47120a3);
+    }
+    {
+        // Seeking and splitting are consistent with sequential output
+        auto check_streams = [](auto source) {
+            auto a = source.split(7), b = source.split(7), c = source.split(8);
+            std::vector<std::uint32_t> words(1000);
+            for (auto &w : words)
+                w = a();
+            assert(a.tell() == 1000);
+            for (std::uint64_t offset : {0, 1, 31, 32, 63, 64, 65, 999})
+            {
+                b.seek(offset);
+                assert(b.tell() == offset);
+                for (auto i = offset; i < words.size(); ++i)
+                    assert(b() == words[i]);
+            }
+            assert(c() != words[0] || c() != words[1]);
+
+            // A store for each chunk gives the same outputs however the chunks are scheduled
+            auto chunk = [&](int i) {
+                auto es = entropy_store32{bit_generator{source.split(i)}};
+                return es(uniform_distribution{1, 1000000}) + es(uniform_distribution{1, 1000000});
+            };
+            assert(chunk(3) == chunk(3) && chunk(4) == chunk(4));
+        };
+        check_streams(philox4x32{rd});
+        check_streams(chacha20{rd});
+    }
+    count_totals(entropy_converter{counter{bit_generator{philox4x32{rd}}}, uniform_distribution{1, 6}}, N);
+    count_totals(entropy_converter{counter{bit_generator{chacha20{rd}}}, uniform_distribution{1, 6}}, N);
+
+    // 64-bit source with bulk fill and jumps
+    {
+        xoshiro256pp a{42}, b{42};
+        std::vector<std::uint64_t> words(100);
+        a.fill(words);
+        for (auto w : words)
+            assert(w == b());
+        a.jump();
+        b.jump();
+        assert(a() == b());
+        b.long_jump();
+        assert(a() != b());
+
+        // bit_generator reads words in blocks using fill(), in the same order
+        bit_generator<xoshiro256pp> bit_source{xoshiro256pp{7}};
+        xoshiro256pp word_source{7};
+        for (int i = 0; i < 40; ++i)
+        {
+            auto word = word_source();
+            for (int j = 0; j < 64; ++j)
+                assert(bit_source() == ((word >> j) & 1));
+        }
+    }
+    count_totals(entropy_converter{counter{bit_generator{xoshiro256pp{rd}}}, uniform_distribution{1, 6}}, N);
+    count_totals(entropy_converter64{counter{bit_generator{xoshiro256pp{rd}}}, uniform_distribution{1, 6}}, N);
+
+    // Bulk sources give the same words from fill() as from single calls
+    {
+        auto check_fill = [](auto a) {
+            auto b = a;
+            std::vector<std::uint32_t> words(1003);
+            a.fill(std::span{words}.first(5));
+            a.fill(std::span{words}.subspan(5));
+            for (auto w : words)
+                assert(w == b());
+        };
+        check_fill(xoshiro128x8{rd});
+        check_fill(philox4x32{rd});
+        check_fill(chacha20{rd});
+
+        // Lane 0 of xoshiro128x8 is a xoshiro128 with the same seed
+        philox4x32 seed1{1}, seed2{1};
+        xoshiro128x8 lanes{seed1};
+        xoshiro128 lane0{seed2};
+        for (int t = 0; t < 100; ++t)
+        {
+            assert(lanes() == lane0());
+            for (int i = 1; i < 8; ++i)
+                lanes();
+        }
+    }
+    count_totals(entropy_converter{counter{bit_generator{xoshiro128x8{rd}}}, uniform_distribution{1, 6}}, N);
+
+    // Replaying a capture from a file
+    {
+        auto path = (std::filesystem::temp_directory_path() / "entropy_store_capture.bin").string();
+        xoshiro256pp capture_source{rd};
+        std::vector<std::uint32_t> capture(100003);
+        for (auto &w : capture)
+            w = std::uint32_t(capture_source());
+        {
+            std::ofstream file(path, std::ios::binary);
+            file.write(reinterpret_cast<const char *>(capture.data()), capture.size() * sizeof(std::uint32_t));
+            file.put(1); // A partial word is ignored
+        }
+
+        mmap_entropy_source replay{path};
+        assert(replay.size() == capture.size());
+        for (int i = 0; i < 10; ++i)
+            assert(replay() == capture[i]);
+        auto copy = replay;
+        assert(replay.remaining().size() == capture.size() - 10);
+        assert(replay.remaining()[0] == capture[10]);
+        replay.discard(capture.size() - 11);
+        assert(replay() == capture.back());
+        assert(replay.exhausted());
+        bool threw = false;
+        try
+        {
+            replay();
+        }
+        catch (const entropy_exhausted &e)
+        {
+            threw = e.consumed() == capture.size();
+        }
+        assert(threw);
+        assert(copy() == capture[10]);
+
+        count_totals(entropy_converter{counter{bit_generator{mmap_entropy_source{path}}}, uniform_distribution{1, 6}},
+                     N);
+        std::filesystem::remove(path);
+
+        threw = false;
+        try
+        {
+            mmap_entropy_source missing{path};
+        }
+        catch (const std::system_error &)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // Mixed-radix packing round trips, including from the start of each block
+    {
+        std::mt19937 mt;
+        std::vector<std::uint64_t> radices, values;
+        mixed_radix_encoder encoder(100);
+        for (int i = 0; i < 10000; ++i)
+        {
+            // Include a run of radix 1 across block boundaries, and some radices too large to share a word
+            std::uint64_t radix = i >= 2050 && i < 2350 ? 1 : i % 97 == 0 ? std::uint64_t(1) << 40 : 2 + mt() % 10;
+            radices.push_back(radix);
+            values.push_back((std::uint64_t(mt()) << 32 | mt()) % radix);
+            encoder.push(values.back(), radix);
+        }
+        encoder.flush();
+        assert(encoder.blocks().size() == 100);
+
+        mixed_radix_decoder decoder{encoder};
+        for (int i = 0; i < values.size(); ++i)
+            assert(decoder.pop(radices[i]) == values[i]);
+        for (int b : {99, 0, 21, 22, 23, 50})
+        {
+            decoder.seek_block(b);
+            for (int i = 100 * b; i < 100 * b + 100; ++i)
+                assert(decoder.pop(radices[i]) == values[i]);
+        }
+
+        // Small radices pack to within a few percent of log2 of their product
+        mixed_radix_encoder fields;
+        double optimal = 0;
+        for (int i = 0; i < 100000; ++i)
+        {
+            std::uint64_t radix = std::array{3, 5, 6, 10}[i % 4];
+            fields.push(mt() % radix, radix);
+            optimal += std::log2(radix);
+        }
+        fields.flush();
+        assert(fields.bits() < 1.03 * optimal);
+    }
+
+    // Digit streams, including a last group shorter than the others
+    {
+        auto check_digits = [&](auto es, auto dist, double min_efficiency) {
+            std::vector<char> out(1000 * N + 7);
+            auto before = bits_fetched(es);
+            es(dist, std::span{out});
+            double efficiency = out.size() * std::log2(dist.alphabet().size()) / (bits_fetched(es) - before);
+            assert(efficiency >= min_efficiency && efficiency <= 1.01);
+            double expected = double(out.size()) / dist.alphabet().size();
+            for (auto c : dist.alphabet())
+                assert(std::abs(std::count(out.begin(), out.end(), c) - expected) < 5 * std::sqrt(expected));
+            assert(std::string_view(dist.alphabet().data(), dist.alphabet().size()).find(es(dist)) !=
+                   std::string_view::npos);
+        };
+        check_digits(entropy_store32{bits}, digit_stream<10>{}, 0.99);
+        check_digits(entropy_store64{bits}, digit_stream<10>{}, 0.99);
+        check_digits(entropy_store64{bits}, digit_stream<62>{}, 0.99);
+        check_digits(entropy_store64{counter{chunk_generator<xoshiro256pp, 16>{xoshiro256pp{rd}}}}, digit_stream<36>{},
+                     0.99);
+        check_digits(entropy_store32{bits}, digit_stream<4>{"ACGT"}, 0.99);
+    }
+
+    // Instrumented stores account for all the entropy they fetch, for each distribution type. A small
+    // buffer makes rejections common enough to count.
+    {
+        ::entropy_store::entropy_store<decltype(bits), std::uint16_t, counting_instrumentation> es{bits};
+        auto before = bits_fetched(es);
+        const uniform_distribution d6(1, 6);
+        for (int i = 0; i < 100 * N; i++)
+            es(d6);
+        for (int i = 0; i < 10 * N; i++)
+            es(const_uniform<0, 9>{});
+        auto dice = es.instrumentation().stats<uniform_distribution<int>>();
+        auto digits = es.instrumentation().stats<const_uniform<0, 9>>();
+        auto total = es.instrumentation().total();
+        assert(dice.outputs == 100 * N && digits.outputs == 10 * N);
+        assert(dice.rejections > 0 && dice.refills > 0 && dice.refills <= dice.fetches);
+        assert(total.fetches == dice.fetches + digits.fetches && es.instrumentation().snapshot().size() == 2);
+        assert(total.fetches == bits_fetched(es) - before);
+        double output_bits = dice.outputs * std::log2(6) + digits.outputs * std::log2(10);
+        assert(std::abs(output_bits + total.discarded_bits + std::log2(es.size()) - total.fetches) < 1e-6 * total.fetches);
+        assert(es.instrumentation().stats<bernoulli_distribution>().outputs == 0);
+    }
+
+    // Telemetry aggregates the stores of a pool, including copies and stores that have been destroyed
+    {
+        entropy_telemetry telemetry;
+        entropy_telemetry::snapshot_type published;
+        telemetry.on_publish([&](auto &snapshot) { published = snapshot; });
+        using telemetry_store = ::entropy_store::entropy_store<decltype(bits), std::uint16_t, telemetry_instrumentation>;
+        telemetry_store a{bits, telemetry_instrumentation{telemetry}};
+        std::size_t fetched = 0;
+        {
+            telemetry_store b = a;
+            for (int i = 0; i < 100 * N; i++)
+                b(uniform_distribution(1, 6));
+            fetched += bits_fetched(b) - bits_fetched(a);
+        }
+        auto before = bits_fetched(a);
+        for (int i = 0; i < 100 * N; i++)
+            a(const_bernoulli<1, 3>{});
+        fetched += bits_fetched(a) - before;
+
+        auto snapshot = telemetry.publish();
+        assert(published.outputs == snapshot.outputs && snapshot.outputs == 200 * N && snapshot.stores == 1);
+        assert(snapshot.fetches == fetched && snapshot.input_bits == fetched && snapshot.rejections > 0);
+        double expected = 100 * N * (std::log2(6) + entropy(const_bernoulli<1, 3>{}));
+        assert(std::abs(snapshot.output_bits - expected) < 0.01 * expected);
+        assert(snapshot.efficiency() > 0.99 && snapshot.efficiency() < 1.01);
+        assert((telemetry.snapshot() - snapshot).outputs == 0);
+
+        std::ostringstream prometheus;
+        write_prometheus(prometheus, snapshot);
+        assert(prometheus.str().find("# TYPE entropy_store_outputs_total counter\nentropy_store_outputs_total " +
+                                     std::to_string(200 * N) + "\n") != std::string::npos);
+
+        double gaussian = std::log2(20 * std::sqrt(2 * std::numbers::pi * std::numbers::e));
+        assert(std::abs(entropy(discrete_gaussian_distribution{20}) - gaussian) < 1e-3);
+        assert(std::abs(entropy(cdt_gaussian_distribution{20}) - gaussian) < 1e-3);
+        assert(std::abs(entropy(negative_binomial_distribution{1, 1, 4}) - entropy(geometric_distribution{1, 4})) <
+               1e-9);
+
+        // Zipf rejects whole draws without a counted rejection sample, so output bits come from its entropy
+        zipf_distribution zipf{1000, 1.1};
+        std::array<char, 10> digits;
+        for (int i = 0; i < 10 * N; i++)
+        {
+            a(zipf);
+            a(digit_stream<10>{}, std::span{digits});
+        }
+        auto interval = telemetry.snapshot() - snapshot;
+        expected = 10 * N * (entropy(zipf) + 10 * std::log2(10));
+        assert(interval.outputs == 20 * N && std::abs(interval.output_bits - expected) < 1e-6 * expected);
+        assert(interval.efficiency() < 0.9 && interval.input_bits - interval.discarded_bits > 1.1 * expected);
+
+        // Assignment never shares counters, which have a single writer
+        entropy_telemetry other_telemetry;
+        telemetry_instrumentation assigned{telemetry}, other_store{telemetry};
+        assigned = a.instrumentation();
+        assert(&assigned.counters() != &a.instrumentation().counters());
+        other_store = telemetry_instrumentation{other_telemetry};
+        assert(other_telemetry.snapshot().stores == 1 && &other_store.counters() != &assigned.counters());
+
+        // A table built for each call, likely at the same address, is not mistaken for the last one
+        auto generate_table = [&](std::uint32_t weight) { return a(weighted_distribution{1, weight}); };
+        auto before_tables = telemetry.snapshot();
+        for (int i = 0; i < N; i++)
+            generate_table(i % 2 ? 1 : 3);
+        expected = N / 2 * (entropy(weighted_distribution{1, 1}) + entropy(weighted_distribution{1, 3}));
+        assert(std::abs((telemetry.snapshot() - before_tables).output_bits - expected) < 1e-6 * expected);
+    }
+
+    // The statistical test battery passes good outputs, gives the same results in parallel chunks,
+    // and catches biased and correlated outputs
+    {
+        assert(std::abs(chi_squared_p_value(3.841459, 1) - 0.05) < 1e-6);
+        assert(std::abs(chi_squared_p_value(18.307038, 10) - 0.05) < 1e-6);
+        assert(std::abs(chi_squared_p_value(1e6 + 1414.2, 1e6) - 0.1587) < 1e-3);
+        assert(std::abs(normal_p_value(1.959964) - 0.05) < 1e-6);
+
+        const std::vector<double> d6(6, 1.0 / 6);
+        auto es = entropy_store32{bits};
+        std::vector<test_battery::value_type> values(1000 * N);
+        for (auto &v : values)
+            v = es(uniform_distribution(0, 5));
+        test_battery sequential{d6, 3};
+        sequential.add(values);
+        auto results = sequential.results();
+        assert(results.size() == 5 && sequential.tuple_size() == 3);
+        for (auto &r : results)
+            assert(r.p_value > 1e-6);
+
+        std::size_t next = 0;
+        auto parallel = run_battery(
+            [&](auto chunk) {
+                std::copy_n(values.begin() + next, chunk.size(), chunk.begin());
+                next += chunk.size();
+            },
+            test_battery{d6, 3}, values.size(), 3, 999);
+        assert(parallel.size() == values.size());
+        for (std::size_t i = 0; i < results.size(); ++i)
+            assert(std::abs(parallel.results()[i].statistic - results[i].statistic) <
+                   1e-9 * (1 + std::abs(results[i].statistic)));
+
+        auto failures = [&](auto fill) {
+            test_battery battery{d6};
+            auto results = run_battery(fill, battery, 1000 * N, 2).results();
+            return std::ranges::count_if(results, [](auto &r) { return r.p_value < 1e-6; });
+        };
+        std::mt19937 mt;
+        assert(failures([&](auto chunk) {
+                   for (auto &v : chunk)
+                       v = mt() % 7 % 6; // 0 is twice as likely
+               }) > 0);
+        assert(failures([&, previous = 0u](auto chunk) mutable {
+                   for (auto &v : chunk)
+                       v = previous = mt() % 8 ? mt() % 6 : previous;
+               }) > 0);
+    }
+
+    // The analysis predicts the bits a store discards, within its error, and the sampled estimate
+    // agrees with the exact analysis
+    {
+        ::entropy_store::entropy_store<decltype(bits), std::uint16_t, counting_instrumentation> es{bits};
+        auto config = configuration_of<std::uint16_t>(bits.distribution());
+        assert(config.N == 1 << 14 && config.source_size == 2);
+        auto d1000 = analyze_uniform(config, 1000);
+        assert(d1000.exact && d1000.error < 1e-6 && d1000.lost_bits < worst_case_loss(1000, config.N));
+        for (int i = 0; i < 100 * N; i++)
+            es(uniform_distribution(1, 1000));
+        double discarded = es.instrumentation().total().discarded_bits / (100 * N);
+        assert(std::abs(discarded - d1000.lost_bits) < 0.1 * d1000.lost_bits);
+
+        assert(analyze_uniform(config, 64).lost_bits == 0 && analyze_uniform(config, 6).lost_bits > 0);
+        auto exact = analyze_bernoulli(config, 1, 3);
+        const std::uint32_t weights[] = {2, 1};
+        auto sampled = estimate_weighted(config, weights);
+        assert(!sampled.exact && std::abs(exact.lost_bits - sampled.lost_bits) < exact.error + sampled.error);
+        assert(std::abs(exact.efficiency() - 1) < 0.001);
+    }
+
+    // Refill policies refill less often than the default, and lose the entropy that the analysis
+    // predicts, within their bounds
+    {
+        static_assert(target_loss<4>::threshold(1u << 30, 6u) == 96 && max_throughput::threshold(1u << 30, 6u) == 6);
+        static_assert(target_loss<40>::threshold(1u << 30, 6u) == 1u << 30);
+        using policy_store = ::entropy_store::entropy_store<decltype(bits), std::uint32_t, counting_instrumentation,
+                                                            target_loss<4>>;
+        policy_store es{bits};
+        ::entropy_store::entropy_store<decltype(bits), std::uint32_t, counting_instrumentation> default_es{bits};
+        int counts[6] = {};
+        for (int i = 0; i < 100 * N; i++)
+        {
+            counts[es(uniform_distribution(0, 5))]++;
+            default_es(uniform_distribution(0, 5));
+        }
+        for (auto c : counts)
+            assert(std::abs(c - 100 * N / 6.0) < 0.05 * 100 * N / 6.0);
+        auto stats = es.instrumentation().total();
+        assert(stats.refills < default_es.instrumentation().total().refills / 5);
+
+        auto config = refilling_by<target_loss<4>>(configuration_of<std::uint32_t>(bits.distribution()), 6);
+        const std::uint32_t weights[] = {1, 1, 1, 1, 1, 1};
+        auto predicted = estimate_weighted(config, weights);
+        double discarded = stats.discarded_bits / (100 * N);
+        assert(std::abs(discarded - predicted.lost_bits) < 0.2 * predicted.lost_bits);
+        assert(discarded < worst_case_loss(6, config) && worst_case_loss(6, config) < 0.32);
+        double output_bits = 100 * N * std::log2(6);
+        assert(std::abs(output_bits + stats.discarded_bits + std::log2(es.size()) - stats.fetches) <
+               1e-6 * stats.fetches);
+    }
+
+    // A reserved source bounds the fetches of each output while it does not overrun, even after the
+    // failed samples that are common in a small buffer, and keeps the entropy it has reserved
+    {
+        ::entropy_store::entropy_store<reserved_source<decltype(bits)>, std::uint16_t> es{{bits, 128, 16}};
+        auto &reserve = es.source();
+        assert(reserve.reserved() == 128 && bits_fetched(es) == 128);
+        for (int i = 0; i < 100 * N; i++)
+        {
+            auto before = bits_fetched(es);
+            es(uniform_distribution(1, 1000));
+            assert(bits_fetched(es) - before <= 16);
+        }
+        assert(reserve.overruns() == 0 && reserve.reserved() > 64);
+        double output_bits = 100 * N * std::log2(1000);
+        assert(std::abs(bits_fetched(es) - internal_entropy(es) - output_bits) < 0.03 * output_bits);
+
+        // Overruns count outputs, not the values they fetch past the reserve
+        ::entropy_store::entropy_store<reserved_source<decltype(bits)>, std::uint16_t> small{{bits, 1, 1}};
+        for (int i = 0; i < N; i++)
+            small(uniform_distribution(1, 1000));
+        assert(small.source().overruns() > 0 && small.source().overruns() <= std::size_t(N));
+    }
+
+    // Prefilled and reserved entropy is used before the source is called again, and a helper thread
+    // can fill the reserve while the store generates
+    {
+        auto es = entropy_store32{bits};
+        es.prefill();
+        auto before = bits_fetched(es);
+        assert(es.size() >= (1u << 30) && before >= 30);
+        es(const_uniform<1, 6>{});
+        assert(bits_fetched(es) == before && es.reserve(1000) < 32);
+
+        ::entropy_store::entropy_store<reserved_source<decltype(bits)>> reserved{{bits, 16, 0}};
+        assert(reserved.reserve(10000) >= 10000 && reserved.source().capacity() >= 10000 - 32);
+        before = bits_fetched(reserved);
+        for (int i = 0; i < 3000; i++)
+            reserved(const_uniform<1, 6>{});
+        assert(bits_fetched(reserved) == before && reserved.source().overruns() == 0);
+
+        ::entropy_store::entropy_store<reserved_source<decltype(bits)>> helped{{bits, 64, 0}};
+        {
+            std::jthread filler([&](std::stop_token stop) {
+                while (!stop.stop_requested())
+                    if (!helped.source().replenish(16))
+                        std::this_thread::yield();
+            });
+            for (int i = 0; i < 100 * N; i++)
+                assert(helped(uniform_distribution(1, 6)) <= 6);
+        }
+        double output_bits = 100 * N * std::log2(6);
+        assert(std::abs(bits_fetched(helped) - internal_entropy(helped) - output_bits) < 0.001 * output_bits);
+
+        // Without a helper, an output fails instead of waiting forever
+        ::entropy_store::entropy_store<reserved_source<decltype(bits)>> starved{
+            {bits, 16, 0, std::chrono::milliseconds(1)}};
+        bool thrown = false;
+        try
+        {
+            starved(const_uniform<1, 6>{});
+        }
+        catch (const reserve_starved &)
+        {
+            thrown = true;
+        }
+        assert(thrown && starved.source().overruns() == 1);
+    }
+
     count_totals(entropy_converter{bits, const_uniform<1, 3>{}}, N);
     count_totals(entropy_converter64{bits, const_uniform<1, 3>{}}, N);
     count_totals(entropy_converter{bits, const_bernoulli<1, 3>{}}, N, 0.96, 1.04);
@@ -92,5 +991,9 @@ int main(int argc, char **argv)
     std::cout << "ALDR: ";
     count_totals(aldr_source{bits, weighted_distribution{1, 2, 3, 4, 5}}, N, 0.69);
 
+    std::cout << "FLDR view: ";
+    const weighted_distribution d6_table{1, 1, 1, 1, 1, 1};
+    count_totals(fldr_source{bits, weighted_view{d6_table}}, N, 0.69);
+
     std::cout << "\nAll tests passed!\n";
 }
\ No newline at end of file
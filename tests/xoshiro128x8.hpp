@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace entropy_store
+{
+// Eight interleaved xoshiro128++ generators, so that fill() produces eight words per step.
+// Lane i starts i jumps of 2^64 after lane 0, so the lanes never overlap, and output word
+// 8t+i is the t-th output of lane i. With AVX2 each step is a handful of vector instructions;
+// otherwise the lane loops are left to the compiler's vectorizer.
+class xoshiro128x8
+{
+  public:
+    using value_type = std::uint32_t;
+    using distribution_type = const_uniform_distribution<value_type, std::numeric_limits<value_type>::min(),
+                                                         std::numeric_limits<value_type>::max()>;
+
+    static constexpr std::size_t lanes = 8;
+
+    template <entropy_generator Seed>
+        requires(!std::is_same_v<Seed, xoshiro128x8>)
+    xoshiro128x8(Seed &seed)
+    {
+        std::uint32_t state[4];
+        for (auto &word : state)
+            word = seed();
+        for (std::size_t i = 0; i < lanes; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+                s[j][i] = state[j];
+            jump(state);
+        }
+    }
+
+    constexpr distribution_type distribution() const
+    {
+        return {};
+    }
+
+    constexpr value_type min() const
+    {
+        return 0;
+    }
+    constexpr value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+    value_type operator()()
+    {
+        if (m_index == m_buffer.size())
+        {
+            fill(m_buffer);
+            m_index = 0;
+        }
+        return m_buffer[m_index++];
+    }
+
+    // Writes the next words: any that are already buffered, then 8 at a time, then the remainder
+    void fill(std::span<value_type> words)
+    {
+        auto out = words.data(), end = words.data() + words.size();
+        while (m_index < m_buffer.size() && out < end)
+            *out++ = m_buffer[m_index++];
+        auto steps = (end - out) / lanes;
+#ifdef __AVX2__
+        __m256i s0 = load(0), s1 = load(1), s2 = load(2), s3 = load(3);
+        for (std::size_t t = 0; t < steps; ++t, out += lanes)
+        {
+            __m256i result = _mm256_add_epi32(rotl(_mm256_add_epi32(s0, s3), 7), s0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), result);
+            __m256i t1 = _mm256_slli_epi32(s1, 9);
+            s2 = _mm256_xor_si256(s2, s0);
+            s3 = _mm256_xor_si256(s3, s1);
+            s1 = _mm256_xor_si256(s1, s2);
+            s0 = _mm256_xor_si256(s0, s3);
+            s2 = _mm256_xor_si256(s2, t1);
+            s3 = rotl(s3, 11);
+        }
+        store(0, s0);
+        store(1, s1);
+        store(2, s2);
+        store(3, s3);
+#else
+        for (std::size_t t = 0; t < steps; ++t, out += lanes)
+        {
+            for (std::size_t i = 0; i < lanes; ++i)
+            {
+                out[i] = rotl(s[0][i] + s[3][i], 7) + s[0][i];
+                const std::uint32_t t1 = s[1][i] << 9;
+                s[2][i] ^= s[0][i];
+                s[3][i] ^= s[1][i];
+                s[1][i] ^= s[2][i];
+                s[0][i] ^= s[3][i];
+                s[2][i] ^= t1;
+                s[3][i] = rotl(s[3][i], 11);
+            }
+        }
+#endif
+        for (; out < end; ++out)
+            *out = (*this)();
+    }
+
+    int bits() const
+    {
+        return 32;
+    }
+
+  private:
+    static std::uint32_t rotl(const std::uint32_t x, int k)
+    {
+        return (x << k) | (x >> (32 - k));
+    }
+
+#ifdef __AVX2__
+    static __m256i rotl(__m256i x, int k)
+    {
+        return _mm256_or_si256(_mm256_slli_epi32(x, k), _mm256_srli_epi32(x, 32 - k));
+    }
+
+    __m256i load(int j) const
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s[j]));
+    }
+
+    void store(int j, __m256i x)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(s[j]), x);
+    }
+#endif
+
+    // Advances a xoshiro128++ state by 2^64 steps
+    static void jump(std::uint32_t (&state)[4])
+    {
+        static constexpr std::uint32_t polynomial[] = {0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b};
+        std::uint32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (auto p : polynomial)
+            for (int b = 0; b < 32; b++)
+            {
+                if (p & std::uint32_t(1) << b)
+                {
+                    s0 ^= state[0];
+                    s1 ^= state[1];
+                    s2 ^= state[2];
+                    s3 ^= state[3];
+                }
+                const std::uint32_t t = state[1] << 9;
+                state[2] ^= state[0];
+                state[3] ^= state[1];
+                state[1] ^= state[2];
+                state[0] ^= state[3];
+                state[2] ^= t;
+                state[3] = rotl(state[3], 11);
+            }
+        state[0] = s0;
+        state[1] = s1;
+        state[2] = s2;
+        state[3] = s3;
+    }
+
+    // s[word][lane]
+    alignas(32) std::uint32_t s[4][lanes];
+    std::array<value_type, 8 * lanes> m_buffer;
+    std::size_t m_index = m_buffer.size();
+};
+
+inline double internal_entropy(const xoshiro128x8 &)
+{
+    return 0;
+}
+
+} // namespace entropy_store
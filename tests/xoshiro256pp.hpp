@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+namespace entropy_store
+{
+// Code adapted from https://prng.di.unimi.it/xoshiro256plusplus.c
+// A 64-bit generator with jump() and long_jump() to create non-overlapping substreams,
+// and fill() to generate many words in a single call.
+class xoshiro256pp
+{
+  public:
+    using value_type = std::uint64_t;
+    using distribution_type = const_uniform_distribution<value_type, std::numeric_limits<value_type>::min(),
+                                                         std::numeric_limits<value_type>::max()>;
+
+    // Seeds the state with SplitMix64, as recommended by the authors
+    explicit xoshiro256pp(std::uint64_t seed = 0)
+    {
+        for (auto &word : s)
+        {
+            std::uint64_t z = (seed += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    // Seeds the state from a 32-bit source, two words at a time
+    template <entropy_generator Seed>
+        requires(!std::is_same_v<Seed, xoshiro256pp>)
+    xoshiro256pp(Seed &seed)
+    {
+        for (auto &word : s)
+        {
+            word = seed();
+            word = (word << 32) | seed();
+        }
+    }
+
+    constexpr distribution_type distribution() const
+    {
+        return {};
+    }
+
+    constexpr value_type min() const
+    {
+        return 0;
+    }
+    constexpr value_type max() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+
+    value_type operator()()
+    {
+        const std::uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+
+        const std::uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+
+        s[2] ^= t;
+
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    // Writes the next words.size() outputs, keeping the state in registers
+    void fill(std::span<value_type> words)
+    {
+        std::uint64_t s0 = s[0], s1 = s[1], s2 = s[2], s3 = s[3];
+        for (auto &word : words)
+        {
+            word = rotl(s0 + s3, 23) + s0;
+            const std::uint64_t t = s1 << 17;
+            s2 ^= s0;
+            s3 ^= s1;
+            s1 ^= s2;
+            s0 ^= s3;
+            s2 ^= t;
+            s3 = rotl(s3, 45);
+        }
+        s[0] = s0;
+        s[1] = s1;
+        s[2] = s2;
+        s[3] = s3;
+    }
+
+    // Equivalent to 2^128 calls, giving 2^128 non-overlapping subsequences
+    void jump()
+    {
+        static constexpr std::uint64_t polynomial[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa,
+                                                       0x39abdc4529b1661c};
+        jump(polynomial);
+    }
+
+    // Equivalent to 2^192 calls, giving 2^64 starting points that each have 2^64 jump() subsequences
+    void long_jump()
+    {
+        static constexpr std::uint64_t polynomial[] = {0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241,
+                                                       0x39109bb02acbe635};
+        jump(polynomial);
+    }
+
+    int bits() const
+    {
+        return 64;
+    }
+
+  private:
+    static std::uint64_t rotl(const std::uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    void jump(const std::uint64_t (&polynomial)[4])
+    {
+        std::uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (auto p : polynomial)
+            for (int b = 0; b < 64; b++)
+            {
+                if (p & std::uint64_t(1) << b)
+                {
+                    s0 ^= s[0];
+                    s1 ^= s[1];
+                    s2 ^= s[2];
+                    s3 ^= s[3];
+                }
+                (*this)();
+            }
+
+        s[0] = s0;
+        s[1] = s1;
+        s[2] = s2;
+        s[3] = s3;
+    }
+
+    std::uint64_t s[4];
+};
+
+inline double internal_entropy(const xoshiro256pp &)
+{
+    return 0;
+}
+
+} // namespace entropy_store